@@ -0,0 +1,221 @@
+#include "Board.h"
+#include "MinimaxAI.h"
+#include "PatternKernel.h"
+#include "PatternWeights.h"
+#include "RecordedGames.h"
+
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// Settings shared by every analysed position
+struct AnalyseConfig {
+    SearchLimits limits;
+    float weight = 0;
+    int pruneLimit = 10;
+    unsigned long seed = 1;
+    bool canonicalHash = true;
+    // Pattern weights of every board, PATTERN_LUT if null
+    const PatternLUT *lut = nullptr;
+    // Analyse every position of each game instead of its last one
+    bool allPlies = false;
+};
+
+// Reads input lines for the workers and writes their results, one whole line at a time
+class AnalyseQueue {
+public:
+    explicit AnalyseQueue(istream &in) : m_in(in) {}
+
+    // Next non-empty, non-comment line and its 1-based number, false at the end of the input
+    bool next(string &line, int &lineNumber) {
+        lock_guard<mutex> lock(m_inMutex);
+        while (getline(m_in, line)) {
+            lineNumber = ++m_lines;
+            if (!line.empty() && line[0] != '#') return true;
+        }
+        return false;
+    }
+
+    void write(const string &json) {
+        lock_guard<mutex> lock(m_outMutex);
+        fwrite(json.data(), 1, json.size(), stdout);
+        fflush(stdout);
+    }
+
+private:
+    istream &m_in;
+    mutex m_inMutex, m_outMutex;
+    int m_lines = 0;
+};
+
+string toJson(const vector<Coord> &moves) {
+    string res = "[";
+    for (size_t i = 0; i < moves.size(); ++i)
+        res += (i ? ", [" : "[") + to_string(moves[i].x) + ", " + to_string(moves[i].y) + "]";
+    return res + "]";
+}
+
+// Search the position after the first ply moves, on a board of its own so that results do not depend on the order
+template<int Size>
+string analyse(const vector<Coord> &moves, int ply, int lineNumber, const AnalyseConfig &config) {
+    BasicBoard<Size> board(config.seed);
+    board.setCanonicalHashing(config.canonicalHash);
+    if (config.lut != nullptr) board.setWeights(config.lut);
+    board.load(vector<Coord>(moves.begin(), moves.begin() + ply));
+
+    auto side = ply % 2 ? white : black;
+    BasicMinimaxAI<Size> ai(&board, side, config.weight, config.pruneLimit);
+    ai.setLimits(config.limits);
+    string buff;
+    auto p = ai.calculate(&buff);
+    const auto &stats = ai.getStats();
+
+    int depth = 0;
+    for (const auto &it : stats.iterations)
+        if (it.completed) depth = it.depth;
+    ostringstream out;
+    out << "{\"line\": " << lineNumber << ", \"ply\": " << ply << ", \"side\": \""
+        << (side == black ? "black" : "white") << "\", \"move\": [" << p.x << ", " << p.y << "]";
+    if (ply < (int) moves.size())
+        out << ", \"played\": [" << moves[ply].x << ", " << moves[ply].y << "]";
+    out << ", \"score\": " << p.ai_score << ", \"depth\": " << depth << ", \"pv\": " << toJson(ai.getPV())
+        << ", \"nodes\": " << stats.nodes << ", \"checkmate_nodes\": " << stats.checkmateNodes
+        << ", \"cache_hits\": " << stats.cacheHits << ", \"nps\": " << stats.nps() << ", \"time_ms\": "
+        << stats.timeMs << "}\n";
+    return out.str();
+}
+
+// Plies of the line to analyse, or an error message if the moves are not a legal unfinished game
+template<int Size>
+string checkGame(const vector<Coord> &moves, vector<int> &plies, bool allPlies) {
+    BasicBoard<Size> board(1);
+    plies.clear();
+    for (size_t i = 0; i <= moves.size(); ++i) {
+        if (board.hasEnd()) {
+            if (i < moves.size()) return "move " + to_string(i + 1) + " is after the end of the game";
+            break;
+        }
+        if (allPlies || i == moves.size()) plies.push_back((int) i);
+        if (i == moves.size()) break;
+        auto m = moves[i];
+        if (m.x < 0 || m.y < 0 || m.x >= Size || m.y >= Size || board.getGrid(m.x, m.y) != c_empty)
+            return "move " + to_string(i + 1) + " (" + to_string(m.x) + ", " + to_string(m.y) + ") is illegal";
+        board.set(m.x, m.y, i % 2 ? white : black);
+    }
+    if (board.getCount() == Size * Size) plies.pop_back();
+    return plies.empty() ? "the game is over" : "";
+}
+
+template<int Size>
+int run(istream &in, const AnalyseConfig &config, int threads) {
+    AnalyseQueue queue(in);
+    auto worker = [&]() {
+        string line;
+        int lineNumber;
+        vector<int> plies;
+        while (queue.next(line, lineNumber)) {
+            const char *end;
+            auto moves = parseMoves(line.c_str(), &end);
+            // A line that does not parse to the end is an error too, rather than the game of the moves before it
+            size_t rest = end - line.c_str() + strspn(end, " \t\r");
+            string error;
+            if (rest < line.size()) error = "column " + to_string(rest + 1) + " is not a row,column move";
+            else if (moves.empty()) error = "no moves";
+            else error = checkGame<Size>(moves, plies, config.allPlies);
+            if (!error.empty()) {
+                queue.write("{\"line\": " + to_string(lineNumber) + ", \"error\": \"" + error + "\"}\n");
+                continue;
+            }
+            for (int ply : plies) queue.write(analyse<Size>(moves, ply, lineNumber, config));
+        }
+    };
+    vector<thread> pool;
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto &t : pool) t.join();
+    return 0;
+}
+
+/*
+ * Usage: Analyse [FILE = stdin] [options]
+ * Reads one game per line as "row,column" moves, black first, and prints one JSON object per analysed position with
+ * the best move, its score, the searched depth, the principal variation and the search statistics. Lines are
+ * analysed in parallel, so the output is in completion order; "line" and "ply" tell the positions apart.
+ * Options:
+ *   --size 15 | 19 | 20    --depth N = 8    --time MS = 0    --nodes N = 0    --threads N = all cores
+ *   --weight W = 0         --prune N = 10   --seed S = 1     --sym 0 | 1 = 1
+ *   --weights FILE         pattern and opponent weights of a file, see PatternWeights.h; a later --weight overrides
+ *   --all-plies            analyse the position before every move of the game, with the move played in "played"
+ */
+int main(int argc, char **argv) {
+    AnalyseConfig config;
+    config.limits.timeMs = 0;
+    int size = BOARD_SIZE, threads = (int) max(1u, thread::hardware_concurrency());
+    string path;
+    unique_ptr<PatternLUT> lut;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--all-plies")) {
+            config.allPlies = true;
+            continue;
+        }
+        if (argv[i][0] != '-' || !argv[i][1]) {
+            path = argv[i];
+            continue;
+        }
+        if (i + 1 == argc) {
+            cerr << "Missing value of " << argv[i] << endl;
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (!strcmp(argv[i - 1], "--size")) size = atoi(value);
+        else if (!strcmp(argv[i - 1], "--depth")) config.limits.depth = atoi(value);
+        else if (!strcmp(argv[i - 1], "--time")) config.limits.timeMs = atoi(value);
+        else if (!strcmp(argv[i - 1], "--nodes")) config.limits.nodes = atoll(value);
+        else if (!strcmp(argv[i - 1], "--threads")) threads = max(1, atoi(value));
+        else if (!strcmp(argv[i - 1], "--weight")) config.weight = (float) atof(value);
+        else if (!strcmp(argv[i - 1], "--prune")) config.pruneLimit = atoi(value);
+        else if (!strcmp(argv[i - 1], "--seed")) config.seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(argv[i - 1], "--sym")) config.canonicalHash = atoi(value) != 0;
+        else if (!strcmp(argv[i - 1], "--weights")) {
+            EvalWeights weights;
+            auto error = weights.load(value);
+            if (!error.empty()) {
+                cerr << "Bad weights: " << error << endl;
+                return 1;
+            }
+            lut = make_unique<PatternLUT>(weights.patterns);
+            config.lut = lut.get();
+            config.weight = weights.weight;
+        }
+        else {
+            cerr << "Unknown option " << argv[i - 1] << endl;
+            return 1;
+        }
+    }
+
+    ifstream file;
+    if (!path.empty() && path != "-") {
+        file.open(path);
+        if (!file) {
+            cerr << "Cannot open " << path << endl;
+            return 1;
+        }
+    }
+    istream &in = file.is_open() ? file : cin;
+    switch (size) {
+        case 15:
+            return run<15>(in, config, threads);
+        case 19:
+            return run<19>(in, config, threads);
+        case 20:
+            return run<20>(in, config, threads);
+        default:
+            cerr << "Unsupported board size: " << size << endl;
+            return 1;
+    }
+}
@@ -0,0 +1,161 @@
+#include "Board.h"
+#include "MinimaxAI.h"
+#include "PatternKernel.h"
+#include "PatternWeights.h"
+#include "RecordedGames.h"
+#include "TranspositionTable.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+// Plies of each recorded game searched by the benchmark
+const int BENCH_PLIES[] = {9, 14, 19};
+
+/*
+ * Usage: Bench [--depth N = 6] [--time MS = 0] [--nodes N = 0] [--seed S = 1] [--shared-table NAME] [--weights FILE]
+ *              [--search FILE] [--check-sharing]
+ * Searches fixed positions of the recorded games, printing one JSON object per position and a summary line.
+ * With no time limit and the same seed, the searched trees and chosen moves are the same on every run. A node
+ * budget then fixes the tree across code changes that only change speed, so time_ms compares them.
+ * --shared-table caches in the POSIX shared memory object NAME ("/name"), shared by every process started with the
+ * same name and seed, instead of a cache per position. --weights evaluates with the weights of a file, see
+ * PatternWeights.h, and --search with the search settings of a file written by Spsa.
+ * --check-sharing also searches the opponent's reply to each chosen move sharing the search context of the chosen move,
+ * then with an empty one, and exits 1 unless the replies sharing it hit more entries: the ones of the other side.
+ */
+int main(int argc, char **argv) {
+    SearchLimits limits;
+    limits.depth = 6;
+    limits.timeMs = 0;
+    unsigned long seed = 1;
+    string sharedTable;
+    EvalWeights weights;
+    SearchConfig search;
+    search.weight = 0;
+    search.pruneLimit = 10;
+    bool checkSharing = false;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--check-sharing")) {
+            checkSharing = true;
+            continue;
+        }
+        if (i + 1 == argc) {
+            cerr << "Missing value of " << argv[i] << endl;
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (!strcmp(argv[i - 1], "--depth")) limits.depth = atoi(value);
+        else if (!strcmp(argv[i - 1], "--time")) limits.timeMs = atoi(value);
+        else if (!strcmp(argv[i - 1], "--nodes")) limits.nodes = atoll(value);
+        else if (!strcmp(argv[i - 1], "--seed")) seed = strtoul(value, nullptr, 10);
+        else if (!strcmp(argv[i - 1], "--shared-table")) sharedTable = value;
+        else if (!strcmp(argv[i - 1], "--search")) {
+            auto error = search.load(value);
+            if (!error.empty()) {
+                cerr << "Bad search settings: " << error << endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[i - 1], "--weights")) {
+            auto error = weights.load(value);
+            if (!error.empty()) {
+                cerr << "Bad weights: " << error << endl;
+                return 1;
+            }
+            search.weight = weights.weight;
+        } else {
+            cerr << "Unknown option " << argv[i - 1] << endl;
+            return 1;
+        }
+    }
+
+    const PatternLUT lut(weights.patterns);
+    TranspositionTable table;
+    if (!sharedTable.empty() && !table.openShared(sharedTable, seed, BOARD_SIZE, false, 1 << 22)) {
+        cerr << "Cannot open the shared table " << sharedTable << ": " << table.getError() << endl;
+        return 1;
+    }
+
+    int positions = 0;
+    long long totalNodes = 0, totalTime = 0, sharedHits = 0;
+    unsigned long movesHash = 14695981039346656037ul;
+    for (int g = 0; g < RECORDED_GAME_COUNT; ++g) {
+        auto moves = parseMoves(RECORDED_GAMES[g]);
+        for (int ply : BENCH_PLIES) {
+            if (ply >= (int) moves.size()) continue;
+            Board board(seed);
+            board.setWeights(&lut);
+            for (int j = 0; j < ply; ++j) board.set(moves[j].x, moves[j].y, j % 2 ? white : black);
+            if (board.hasEnd()) continue;
+
+            auto side = ply % 2 ? white : black;
+            MinimaxAI ai(&board, side);
+            if (table.isOpen()) ai.getContext()->setTable(&table);
+            ai.setConfig(search);
+            ai.setLimits(limits);
+            string buff;
+            auto p = ai.calculate(&buff);
+            const auto &stats = ai.getStats();
+
+            int depth = 0;
+            string timeToDepth;
+            for (const auto &it : stats.iterations) {
+                if (!it.completed) continue;
+                depth = it.depth;
+                timeToDepth += (timeToDepth.empty() ? "\"" : ", \"") + to_string(it.depth) + "\": " +
+                               to_string(it.timeMs);
+            }
+            long long nodes = stats.nodes + stats.checkmateNodes;
+            cout << "{\"position\": \"" << g << "@" << ply << "\", \"side\": \"" << (side == black ? "black" : "white")
+                 << "\", \"move\": [" << p.x << ", " << p.y << "], \"score\": " << p.ai_score
+                 << ", \"depth\": " << depth << ", \"nodes\": " << stats.nodes
+                 << ", \"checkmate_nodes\": " << stats.checkmateNodes << ", \"nps\": " << stats.nps()
+                 << ", \"time_ms\": " << stats.timeMs << ", \"time_to_depth\": {" << timeToDepth << "}";
+
+            if (checkSharing) {
+                // The opponent's reply sharing the context of the search above, then with a context of its own. Only
+                // the first one can hit entries of the other side
+                auto replyHits = [&](Board &b, bool shared) {
+                    MinimaxAI reply(&b, static_cast<Chess>(!side));
+                    if (shared) reply.setContext(ai.getContext());
+                    reply.setConfig(search);
+                    reply.setLimits(limits);
+                    string replyBuff;
+                    reply.calculate(&replyBuff);
+                    return reply.getStats().cacheHits;
+                };
+                board.set(p.x, p.y, side);
+                Board alone(seed);
+                alone.setWeights(&lut);
+                for (int j = 0; j < ply; ++j) alone.set(moves[j].x, moves[j].y, j % 2 ? white : black);
+                alone.set(p.x, p.y, side);
+                long long hits = 0, hitsAlone = 0;
+                if (!board.hasEnd()) hits = replyHits(board, true), hitsAlone = replyHits(alone, false);
+                cout << ", \"reply_cache_hits\": " << hits << ", \"reply_cache_hits_alone\": " << hitsAlone;
+                sharedHits += hits - hitsAlone;
+            }
+            cout << "}" << endl;
+
+            positions++;
+            totalNodes += nodes;
+            totalTime += stats.timeMs;
+            movesHash = (movesHash ^ (p.x * BOARD_SIZE + p.y)) * 1099511628211ul;
+        }
+    }
+
+    // moves_hash changes iff a chosen move changes
+    cout << "{\"positions\": " << positions << ", \"depth\": " << limits.depth << ", \"node_limit\": " << limits.nodes
+         << ", \"seed\": " << seed
+         << ", \"nodes\": " << totalNodes << ", \"time_ms\": " << totalTime
+         << ", \"nps\": " << totalNodes * 1000 / (totalTime > 0 ? totalTime : 1) << ", \"moves_hash\": \"" << hex
+         << movesHash << dec << "\"";
+    if (checkSharing) cout << ", \"shared_cache_hits\": " << sharedHits;
+    cout << "}" << endl;
+    // Both sides of a board must share the cache
+    if (checkSharing && sharedHits <= 0) {
+        cerr << "The replies found no entries of the other side" << endl;
+        return 1;
+    }
+    return 0;
+}
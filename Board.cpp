@@ -1,66 +1,161 @@
 #include "Board.h"
 
 #include <algorithm>
+#include <random>
+
+#include "PatternKernel.h"
+#include "Profiler.h"
 
 using namespace std;
 
-Board::Board() {
+template<int Size>
+BasicBoard<Size>::BasicBoard() : BasicBoard(time(nullptr)) {}
+
+template<int Size>
+BasicBoard<Size>::BasicBoard(unsigned long seed) : m_seed(seed), m_weights(&PATTERN_LUT) {
     // Fill board
-    for (auto &i : m_board) for (auto &j : i) j = c_empty;
+    for (auto &i : m_state.cells) i = c_edge;
+    for (int r = 0; r < BOARD_SIZE; ++r)
+        for (int c = 0; c < BOARD_SIZE; ++c)
+            m_state.cells[index(r, c)] = c_empty;
 
     // Init zobrist
-    srand(time(nullptr));
-    m_zobristCode = (static_cast<long>(rand()) << (sizeof(int) * 8)) | rand();
+    mt19937_64 rng(seed);
+    m_zobristEmpty = static_cast<long>(rng());
     for (auto &i : m_zobristTable)
         for (auto &j : i)
             for (long &k : j)
-                k = (static_cast<long>(rand()) << (sizeof(int) * 8)) | rand();
+                k = static_cast<long>(rng());
+    m_zobristTurn = static_cast<long>(rng());
+
+    // Patterns of the empty board, stones only rescan their surroundings
+    rebuild();
 }
 
-void Board::set(int r, int c, Chess player) {
+template<int Size>
+void BasicBoard<Size>::load(const std::vector<Coord> &moves) {
+    for (int r = 0; r < BOARD_SIZE; ++r)
+        for (int c = 0; c < BOARD_SIZE; ++c)
+            m_state.cells[index(r, c)] = c_empty;
+    for (int j = 0; j < (int) moves.size(); ++j) {
+        IN_RANGE(moves[j].x, moves[j].y);
+        assert(getGrid(moves[j].x, moves[j].y) == c_empty);
+        m_state.cells[index(moves[j].x, moves[j].y)] = j % 2 ? white : black;
+    }
+    rebuild();
+}
+
+template<int Size>
+void BasicBoard<Size>::rebuild() {
+    m_state.numChess = 0;
+    m_state.totalScore[black] = m_state.totalScore[white] = 0;
+    for (auto &code : m_state.zobristCode) code = m_zobristEmpty;
+    for (auto &count : m_state.neighborCount)
+        for (auto &row : count)
+            for (auto &n : row) n = 0;
+
+    for (int r = 0; r < BOARD_SIZE; ++r) {
+        for (int c = 0; c < BOARD_SIZE; ++c) {
+            const int idx = index(r, c);
+            for (int p = 0; p < 2; ++p)
+                for (int dir = 0; dir < 4; ++dir)
+                    m_state.pointScores[p][idx][dir] =
+                            calculateScore(idx, static_cast<Chess>(p), static_cast<Direction>(dir));
+
+            auto chess = m_state.cells[idx];
+            if (chess == c_empty) continue;
+            m_state.numChess++;
+            m_state.totalScore[chess] += getScore(r, c, chess);
+            for (int sym = 0; sym < (m_state.canonicalHash ? 8 : 1); ++sym) {
+                auto t = transform(sym, r, c);
+                m_state.zobristCode[sym] ^= m_zobristTable[chess][t.x][t.y];
+            }
+            updateNeighbor(r, c);
+        }
+    }
+    m_state.win = hasFive();
+}
+
+template<int Size>
+void BasicBoard<Size>::set(int r, int c, Chess player) {
+    PROFILE_SCOPE(ps_set);
     IN_RANGE(r, c);
 
     // Ensure the input chess is valid
-    Chess prev = m_board[r][c];
+    Chess prev = m_state.cells[index(r, c)];
     assert(!(prev != c_empty && player != c_empty));
 
     // Adjust chess counter
     if (prev == c_empty) {
-        if (player != c_empty) m_numChess++;
-    } else if (player == c_empty) m_numChess--;
+        if (player != c_empty) m_state.numChess++;
+    } else if (player == c_empty) m_state.numChess--;
 
     // Set chess and do update
-    m_board[r][c] = player;
-    m_zobristCode ^= m_zobristTable[player == c_empty ? prev : player][r][c];
+    m_state.cells[index(r, c)] = player;
+    const Chess changed = player == c_empty ? prev : player;
+    m_state.zobristCode[0] ^= m_zobristTable[changed][r][c];
+    if (m_state.canonicalHash) {
+        for (int sym = 1; sym < 8; ++sym) {
+            auto t = transform(sym, r, c);
+            m_state.zobristCode[sym] ^= m_zobristTable[changed][t.x][t.y];
+        }
+    }
     updateGrid(r, c, prev);
     updateNeighbor(r, c);
 }
 
-int Board::getScore(Chess player) const {
-    return m_totalScore[player];
+template<int Size>
+int BasicBoard<Size>::getScore(Chess player) const {
+    return m_state.totalScore[player];
 }
 
-int Board::getScore(int r, int c, Chess player) const {
-    int res = 0;
-    for (const auto &s : m_pointScores[player]) res += s[r][c];
-    return res;
+template<int Size>
+int BasicBoard<Size>::getScore(int r, int c, Chess player) const {
+    const auto &s = m_state.pointScores[player][index(r, c)];
+    const int *w = m_weights->weights;
+    return w[s[0]] + w[s[1]] + w[s[2]] + w[s[3]];
+}
+
+template<int Size>
+void BasicBoard<Size>::setWeights(const PatternLUT *weights) {
+    m_weights = weights;
+    rebuild();
+}
+
+template<int Size>
+void BasicBoard<Size>::countPatterns(Chess player, int counts[PATTERN_COUNT]) const {
+    fill(counts, counts + PATTERN_COUNT, 0);
+    for (int r = 0; r < BOARD_SIZE; ++r)
+        for (int c = 0; c < BOARD_SIZE; ++c)
+            if (getGrid(r, c) == player)
+                for (auto code : m_state.pointScores[player][index(r, c)]) counts[code]++;
 }
 
-int Board::getCount() const {
-    return m_numChess;
+template<int Size>
+int BasicBoard<Size>::getCount() const {
+    return m_state.numChess;
 }
 
-Chess Board::getGrid(int r, int c) const {
-    return m_board[r][c];
+template<int Size>
+Chess BasicBoard<Size>::getGrid(int r, int c) const {
+    return m_state.cells[index(r, c)];
 }
 
-bool Board::hasEnd() const {
-    return m_win;
+template<int Size>
+bool BasicBoard<Size>::hasEnd() const {
+    return m_state.win;
 }
 
-bool Board::hasNeighbor(int r, int c, int range, int count) const {
+template<int Size>
+Pattern BasicBoard<Size>::getPattern(int r, int c, Chess chess, Direction dir) const {
+    IN_RANGE(r, c);
+    return calculateScore(index(r, c), chess, dir);
+}
+
+template<int Size>
+bool BasicBoard<Size>::hasNeighbor(int r, int c, int range, int count) const {
     assert(range == 2 || range == 1);
-    int dist_1 = m_neighborCount[0][r][c], dist_2 = m_neighborCount[1][r][c];
+    int dist_1 = m_state.neighborCount[0][r][c], dist_2 = m_state.neighborCount[1][r][c];
     assert(dist_1 >= 0 && dist_2 >= 0);
     if (range == 1)
         return dist_1 >= count;
@@ -68,22 +163,147 @@ bool Board::hasNeighbor(int r, int c, int range, int count) const {
         return dist_2 > 0 || dist_1 >= count;
 }
 
-void Board::cache(int score, int depth) {
-    m_cache.insert({m_zobristCode, new CacheData(score, depth)});
+template<int Size>
+unsigned long BasicBoard<Size>::getSeed() const {
+    return m_seed;
 }
 
-CacheData *Board::getCache() const {
-    if (m_cache.find(m_zobristCode) == m_cache.end())
-        return nullptr;
-    return m_cache.at(m_zobristCode);
+template<int Size>
+long BasicBoard<Size>::cacheKey(Chess player) const {
+    return player == white ? getHash() ^ m_zobristTurn : getHash();
 }
 
-unsigned long Board::getCachedSize() const {
-    return m_cache.size() * sizeof(CacheData);
+template<int Size>
+Coord BasicBoard<Size>::transform(int sym, int r, int c) {
+    const int m = BOARD_SIZE - 1;
+    switch (sym) {
+        case 1:
+            return {static_cast<short>(c), static_cast<short>(m - r)};
+        case 2:
+            return {static_cast<short>(m - r), static_cast<short>(m - c)};
+        case 3:
+            return {static_cast<short>(m - c), static_cast<short>(r)};
+        case 4:
+            return {static_cast<short>(r), static_cast<short>(m - c)};
+        case 5:
+            return {static_cast<short>(m - r), static_cast<short>(c)};
+        case 6:
+            return {static_cast<short>(c), static_cast<short>(r)};
+        case 7:
+            return {static_cast<short>(m - c), static_cast<short>(m - r)};
+        default:
+            return {static_cast<short>(r), static_cast<short>(c)};
+    }
+}
+
+template<int Size>
+Coord BasicBoard<Size>::inverseTransform(int sym, int r, int c) {
+    // Rotations by 90 and 270 degrees are each other's inverse, every other symmetry is its own
+    return transform(sym == 1 ? 3 : (sym == 3 ? 1 : sym), r, c);
+}
+
+template<int Size>
+void BasicBoard<Size>::setCanonicalHashing(bool enabled) {
+    m_state.canonicalHash = enabled;
+    if (!enabled) return;
+
+    // Rebuild the symmetric codes from the stones on board, starting from the same seed as the positional one
+    long seed = m_state.zobristCode[0];
+    for (int r = 0; r < BOARD_SIZE; ++r)
+        for (int c = 0; c < BOARD_SIZE; ++c)
+            if (getGrid(r, c) != c_empty) seed ^= m_zobristTable[getGrid(r, c)][r][c];
+    for (int sym = 1; sym < 8; ++sym) {
+        long code = seed;
+        for (int r = 0; r < BOARD_SIZE; ++r) {
+            for (int c = 0; c < BOARD_SIZE; ++c) {
+                if (getGrid(r, c) == c_empty) continue;
+                auto t = transform(sym, r, c);
+                code ^= m_zobristTable[getGrid(r, c)][t.x][t.y];
+            }
+        }
+        m_state.zobristCode[sym] = code;
+    }
+}
+
+template<int Size>
+long BasicBoard<Size>::getHash() const {
+    return m_state.zobristCode[getHashSymmetry()];
 }
 
-std::string Board::to_string(std::vector<Point *> *planned) {
-    std::string res = "  0 1 2 3 4 5 6 7 8 9 0 1 2 3 4\n";
+template<int Size>
+int BasicBoard<Size>::getHashSymmetry() const {
+    if (!m_state.canonicalHash) return 0;
+    int best = 0;
+    for (int sym = 1; sym < 8; ++sym)
+        if (m_state.zobristCode[sym] < m_state.zobristCode[best]) best = sym;
+    return best;
+}
+
+template<int Size>
+const BoardState<Size> &BasicBoard<Size>::getState() const {
+    return m_state;
+}
+
+template<int Size>
+void BasicBoard<Size>::setState(const BoardState<Size> &state) {
+    m_state = state;
+}
+
+template<int Size>
+std::string BasicBoard<Size>::checkState() const {
+    auto at = [](int r, int c) { return "(" + std::to_string(r) + ", " + std::to_string(c) + ")"; };
+
+    int numChess = 0, totalScore[2]{};
+    for (int r = 0; r < BOARD_SIZE; ++r) {
+        for (int c = 0; c < BOARD_SIZE; ++c) {
+            auto chess = getGrid(r, c);
+            if (chess != c_empty) numChess++;
+
+            // Neighbors at distance 1 (the cell itself included) and exactly 2
+            int dist[2]{};
+            for (int i = max(0, r - 2); i <= min(BOARD_SIZE - 1, r + 2); ++i)
+                for (int j = max(0, c - 2); j <= min(BOARD_SIZE - 1, c + 2); ++j)
+                    if (getGrid(i, j) != c_empty) dist[max(abs(i - r), abs(j - c)) == 2]++;
+            if (dist[0] != m_state.neighborCount[0][r][c] || dist[1] != m_state.neighborCount[1][r][c])
+                return "neighborCount at " + at(r, c);
+
+            // Empty cells keep the patterns of both players, stones the ones of their own color
+            for (int p = 0; p < 2; ++p) {
+                if (chess != c_empty && chess != p) continue;
+                for (int dir = 0; dir < 4; ++dir) {
+                    auto expected = calculateScore(index(r, c), static_cast<Chess>(p), static_cast<Direction>(dir));
+                    if (m_state.pointScores[p][index(r, c)][dir] != expected)
+                        return "pointScores[" + std::to_string(p) + "] at " + at(r, c) + " dir " + std::to_string(dir)
+                               + ": " + std::to_string(m_state.pointScores[p][index(r, c)][dir]) + " != "
+                               + std::to_string(expected);
+                }
+            }
+            if (chess != c_empty) totalScore[chess] += getScore(r, c, chess);
+        }
+    }
+    if (numChess != m_state.numChess) return "numChess";
+    for (int p = 0; p < 2; ++p)
+        if (totalScore[p] != m_state.totalScore[p]) return "totalScore[" + std::to_string(p) + "]";
+    if (hasFive() != m_state.win) return "win";
+
+    for (int sym = 0; sym < (m_state.canonicalHash ? 8 : 1); ++sym) {
+        long code = m_zobristEmpty;
+        for (int r = 0; r < BOARD_SIZE; ++r)
+            for (int c = 0; c < BOARD_SIZE; ++c)
+                if (getGrid(r, c) != c_empty) {
+                    auto t = transform(sym, r, c);
+                    code ^= m_zobristTable[getGrid(r, c)][t.x][t.y];
+                }
+        if (code != m_state.zobristCode[sym]) return "zobristCode[" + std::to_string(sym) + "]";
+    }
+    return "";
+}
+
+template<int Size>
+std::string BasicBoard<Size>::to_string(std::vector<Point *> *planned) {
+    std::string res = " ";
+    for (int j = 0; j < BOARD_SIZE; ++j) res += " " + std::to_string(j % 10);
+    res += "\n";
     for (int i = 0; i < BOARD_SIZE; ++i) {
         res += std::to_string(i % 10) + " ";
         for (int j = 0; j < BOARD_SIZE; ++j) {
@@ -95,7 +315,7 @@ std::string Board::to_string(std::vector<Point *> *planned) {
                         break;
                     }
                 }
-            auto ele = m_board[i][j];
+            auto ele = getGrid(i, j);
             switch (ele) {
                 case c_empty:
                     if (flag) res += "x";
@@ -107,6 +327,10 @@ std::string Board::to_string(std::vector<Point *> *planned) {
                 case black:
                     res += "●";
                     break;
+                case c_edge:
+                    // Only the padding holds it, seeing one inside the board means the cells are corrupt
+                    res += "#";
+                    break;
             }
             res += " ";
         }
@@ -115,217 +339,59 @@ std::string Board::to_string(std::vector<Point *> *planned) {
     return res;
 }
 
-Point *Board::heuristicGenerator(Chess player, Chess ai_id, int &resSize, bool checkmateOnly, bool do_sort) {
+template<int Size>
+Point *BasicBoard<Size>::heuristicGenerator(GeneratorContext<Size> &ctx, Chess player, Chess ai_id, int &resSize,
+                                            bool checkmateOnly, bool do_sort) const {
+    PROFILE_SCOPE(ps_generator);
     assert(getCount() > 0);
     auto oppo = static_cast<Chess>(!player);
 
+    auto &ai_5 = ctx.ai_5, &op_5 = ctx.op_5, &ai_4p = ctx.ai_4p, &op_4p = ctx.op_4p, &ai_4m = ctx.ai_4m,
+            &op_4m = ctx.op_4m, &ai_combo = ctx.ai_combo, &op_combo = ctx.op_combo, &ai_double3 = ctx.ai_double3,
+            &op_double3 = ctx.op_double3, &ai_3p = ctx.ai_3p, &op_3p = ctx.op_3p, &ai_2p = ctx.ai_2p,
+            &op_2p = ctx.op_2p, &neighbor = ctx.neighbor;
+
     int i_ai_5 = 0, i_op_5 = 0, i_ai_4p = 0, i_op_4p = 0, i_ai_4m = 0, i_op_4m = 0, i_ai_combo = 0, i_op_combo = 0,
             i_ai_double3 = 0, i_op_double3 = 0, i_ai_3p = 0, i_op_3p = 0, i_ai_2p = 0, i_op_2p = 0, i_neighbor = 0;
 
+    RowSummary<ROW_STRIDE> ai_row, op_row;
     for (int r = 0; r < BOARD_SIZE; ++r) {
+        // Collect the candidate columns first, rows without any are not summarized at all
+        unsigned candidates = 0;
         for (int c = 0; c < BOARD_SIZE; ++c) {
             if (getGrid(r, c) != c_empty) continue;
-            if (!hasNeighbor(r, c, m_numChess < 6 ? 1 : 2, m_numChess < 6 ? 1 : 2)) continue;
-
-            Forms ai_score[4], op_score[4];
-            int ai_total, op_total;
-            ai_total = (ai_score[0] = m_pointScores[player][0][r][c]) +
-                       (ai_score[1] = m_pointScores[player][1][r][c]) +
-                       (ai_score[2] = m_pointScores[player][2][r][c]) +
-                       (ai_score[3] = m_pointScores[player][3][r][c]);
-            op_total = (op_score[0] = m_pointScores[oppo][0][r][c]) +
-                       (op_score[1] = m_pointScores[oppo][1][r][c]) +
-                       (op_score[2] = m_pointScores[oppo][2][r][c]) +
-                       (op_score[3] = m_pointScores[oppo][3][r][c]);
-
-
-            Point p(r, c, ai_total, op_total);
-            int ai_4m_count = 0, op_4m_count = 0, ai_3p_count = 0, op_3p_count = 0, ai_3m_count = 0, op_3m_count = 0,
-                    ai_2p_count = 0, op_2p_count = 0;
-
-            auto ai = ai_score[0], op = op_score[0];
-            // Checkmate!
-            if (ai == _5) {
-                ai_5[i_ai_5++] = p;
-                break;
-            } else if (op == _5) {
-                op_5[i_op_5++] = p;
-                break;
-            } else if (ai == _4p) {
-                ai_4p[i_ai_4p++] = p;
-                break;
-            } else if (op == _4p) {
-                op_4p[i_op_4p++] = p;
-                break;
-            }
-            switch (ai) {
-                case _4m:
-                    ai_4m_count++;
-                    break;
-                case _3p:
-                    ai_3p_count++;
-                    break;
-                case _3m:
-                    ai_3m_count++;
-                    break;
-                case _2p:
-                    ai_2p_count++;
-                default:
-                    break;
-            }
-            switch (op) {
-                case _4m:
-                    op_4m_count++;
-                    break;
-                case _3p:
-                    op_3p_count++;
-                    break;
-                case _3m:
-                    op_3m_count++;
-                    break;
-                case _2p:
-                    op_2p_count++;
-                default:
-                    break;
-            }
-
-            ai = ai_score[1], op = op_score[1];
-            // Checkmate!
-            if (ai == _5) {
-                ai_5[i_ai_5++] = p;
-                break;
-            } else if (op == _5) {
-                op_5[i_op_5++] = p;
-                break;
-            } else if (ai == _4p) {
-                ai_4p[i_ai_4p++] = p;
-                break;
-            } else if (op == _4p) {
-                op_4p[i_op_4p++] = p;
+            if (!hasNeighbor(r, c, m_state.numChess < 6 ? 1 : 2, m_state.numChess < 6 ? 1 : 2)) continue;
+            candidates |= 1u << c;
+        }
+        if (!candidates) continue;
+
+        summarizeRow(m_state.pointScores[player] + index(r, 0), *m_weights, candidates, ai_row);
+        summarizeRow(m_state.pointScores[oppo] + index(r, 0), *m_weights, candidates, op_row);
+
+        for (; candidates; candidates &= candidates - 1) {
+            int c = __builtin_ctz(candidates);
+
+            Point p(r, c, ai_row.total[c], op_row.total[c]);
+
+            // Checkmate! The first direction holding a 5 or 4p decides, ai before op and 5 before 4p
+            unsigned ai_5_dir = ai_row.getMask(t_5, c), op_5_dir = op_row.getMask(t_5, c),
+                    ai_4p_dir = ai_row.getMask(t_4p, c), op_4p_dir = op_row.getMask(t_4p, c);
+            if (unsigned any = ai_5_dir | op_5_dir | ai_4p_dir | op_4p_dir) {
+                unsigned first = any & -any;
+                if (ai_5_dir & first)
+                    ai_5[i_ai_5++] = p;
+                else if (op_5_dir & first)
+                    op_5[i_op_5++] = p;
+                else if (ai_4p_dir & first)
+                    ai_4p[i_ai_4p++] = p;
+                else
+                    op_4p[i_op_4p++] = p;
                 break;
             }
-            switch (ai) {
-                case _4m:
-                    ai_4m_count++;
-                    break;
-                case _3p:
-                    ai_3p_count++;
-                    break;
-                case _3m:
-                    ai_3m_count++;
-                    break;
-                case _2p:
-                    ai_2p_count++;
-                default:
-                    break;
-            }
-            switch (op) {
-                case _4m:
-                    op_4m_count++;
-                    break;
-                case _3p:
-                    op_3p_count++;
-                    break;
-                case _3m:
-                    op_3m_count++;
-                    break;
-                case _2p:
-                    op_2p_count++;
-                default:
-                    break;
-            }
 
-            ai = ai_score[2], op = op_score[2];
-            // Checkmate!
-            if (ai == _5) {
-                ai_5[i_ai_5++] = p;
-                break;
-            } else if (op == _5) {
-                op_5[i_op_5++] = p;
-                break;
-            } else if (ai == _4p) {
-                ai_4p[i_ai_4p++] = p;
-                break;
-            } else if (op == _4p) {
-                op_4p[i_op_4p++] = p;
-                break;
-            }
-            switch (ai) {
-                case _4m:
-                    ai_4m_count++;
-                    break;
-                case _3p:
-                    ai_3p_count++;
-                    break;
-                case _3m:
-                    ai_3m_count++;
-                    break;
-                case _2p:
-                    ai_2p_count++;
-                default:
-                    break;
-            }
-            switch (op) {
-                case _4m:
-                    op_4m_count++;
-                    break;
-                case _3p:
-                    op_3p_count++;
-                    break;
-                case _3m:
-                    op_3m_count++;
-                    break;
-                case _2p:
-                    op_2p_count++;
-                default:
-                    break;
-            }
-
-            ai = ai_score[3], op = op_score[3];
-            // Checkmate!
-            if (ai == _5) {
-                ai_5[i_ai_5++] = p;
-                break;
-            } else if (op == _5) {
-                op_5[i_op_5++] = p;
-                break;
-            } else if (ai == _4p) {
-                ai_4p[i_ai_4p++] = p;
-                break;
-            } else if (op == _4p) {
-                op_4p[i_op_4p++] = p;
-                break;
-            }
-            switch (ai) {
-                case _4m:
-                    ai_4m_count++;
-                    break;
-                case _3p:
-                    ai_3p_count++;
-                    break;
-                case _3m:
-                    ai_3m_count++;
-                    break;
-                case _2p:
-                    ai_2p_count++;
-                default:
-                    break;
-            }
-            switch (op) {
-                case _4m:
-                    op_4m_count++;
-                    break;
-                case _3p:
-                    op_3p_count++;
-                    break;
-                case _3m:
-                    op_3m_count++;
-                    break;
-                case _2p:
-                    op_2p_count++;
-                default:
-                    break;
-            }
+            int ai_4m_count = ai_row.getCount(t_4m, c), op_4m_count = op_row.getCount(t_4m, c),
+                    ai_3p_count = ai_row.getCount(t_3p, c), op_3p_count = op_row.getCount(t_3p, c),
+                    ai_2p_count = ai_row.getCount(t_2p, c), op_2p_count = op_row.getCount(t_2p, c);
 
             // TODO: improve score tolerance
             if (ai_3p_count >= 2)
@@ -362,7 +428,7 @@ Point *Board::heuristicGenerator(Chess player, Chess ai_id, int &resSize, bool c
         return max(b.op_score, b.ai_score) < max(a.op_score, a.ai_score);
     };
     auto concat = [](Point *a, int &n1, Point *b, int n2) {
-        assert(n1 + n2 <= BOARD_SIZE * BOARD_SIZE / 2);
+        assert(n1 + n2 <= BOARD_SIZE * BOARD_SIZE);
         for (int i = 0; i < n2; ++i)
             a[n1++] = b[i];
     };
@@ -430,461 +496,133 @@ Point *Board::heuristicGenerator(Chess player, Chess ai_id, int &resSize, bool c
     concat(ai_2p, i_ai_2p, op_2p, i_op_2p);
     sort(ai_2p, ai_2p + i_ai_2p, bothCom);
     if ((resSize = i_ai_2p) != 0) {
-        if (resSize > 20) resSize = 20;
+        if (resSize > ctx.candidateLimit) resSize = ctx.candidateLimit;
         return ai_2p;
     }
 
     // Others
     sort(neighbor, neighbor + i_neighbor, bothCom);
     resSize = i_neighbor;
-    if (resSize > 20) resSize = 20;
+    if (resSize > ctx.candidateLimit) resSize = ctx.candidateLimit;
     return neighbor;
 }
 
 
-void Board::updateNeighbor(int r, int c) {
+template<int Size>
+void BasicBoard<Size>::updateNeighbor(int r, int c) {
     // Update the 2x2 range
-    int adder = m_board[r][c] == c_empty ? -1 : 1;
+    int adder = getGrid(r, c) == c_empty ? -1 : 1;
     for (int i = max(0, r - 2); i <= min(BOARD_SIZE - 1, r + 2); i++) {
         for (int j = max(0, c - 2); j <= min(BOARD_SIZE - 1, c + 2); j++) {
             if (abs(i - r) <= 1 && abs(j - c) <= 1)
                 // Dist = 1 || 0
-                m_neighborCount[0][i][j] += adder;
+                m_state.neighborCount[0][i][j] += adder;
             else
                 // Dist = 2
-                m_neighborCount[1][i][j] += adder;
-            assert(m_neighborCount[0][i][j] >= 0);
-            assert(m_neighborCount[1][i][j] >= 0);
+                m_state.neighborCount[1][i][j] += adder;
+            assert(m_state.neighborCount[0][i][j] >= 0);
+            assert(m_state.neighborCount[1][i][j] >= 0);
         }
     }
 }
 
-void Board::updateGrid(int r, int c, Chess prev) {
-    const auto chess = m_board[r][c];
+template<int Size>
+void BasicBoard<Size>::updateGrid(int r, int c, Chess prev) {
+    PROFILE_SCOPE(ps_updateGrid);
+    const int idx = index(r, c);
+    const auto chess = m_state.cells[idx];
+    auto &scores = m_state.pointScores;
 
     if (chess != c_empty) {
         // empty -> chess: Calculate score @ (x, y)
-        m_totalScore[chess] +=
-                (m_pointScores[chess][horizontal][r][c] = calculateScore(r, c, chess, horizontal)) +
-                (m_pointScores[chess][vertical][r][c] = calculateScore(r, c, chess, vertical)) +
-                (m_pointScores[chess][diag_RU][r][c] = calculateScore(r, c, chess, diag_RU)) +
-                (m_pointScores[chess][diag_LU][r][c] = calculateScore(r, c, chess, diag_LU));
+        for (int dir = 0; dir < 4; ++dir)
+            scores[chess][idx][dir] = calculateScore(idx, chess, static_cast<Direction>(dir));
+        m_state.totalScore[chess] += getScore(r, c, chess);
     } else {
-        // chess -> empty: Revert score @ (x, y)
-        m_totalScore[prev] -= getScore(r, c, prev);
-    }
-
-    // Update horizontally
-    bool flag[2]{};
-    int count[2]{};
-    for (int ct = c - 1; ct >= max(0, c - SCORE_RANGE); ct--) {
-        IN_RANGE(r, ct);
-        auto ele = m_board[r][ct];
-        if (ele == c_empty) {
-
-            m_pointScores[black][horizontal][r][ct] = calculateScore(r, ct, black, horizontal);
-            m_pointScores[white][horizontal][r][ct] = calculateScore(r, ct, white, horizontal);
-
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
-
-            m_totalScore[ele] -= m_pointScores[ele][horizontal][r][ct];
-            m_totalScore[ele] += (m_pointScores[ele][horizontal][r][ct] = calculateScore(r, ct, ele, horizontal));
-
-        }
-    }
-    flag[0] = flag[1] = false;
-    for (int ct = c + 1; ct < min(BOARD_SIZE, c + SCORE_RANGE); ct++) {
-        IN_RANGE(r, ct);
-        auto ele = m_board[r][ct];
-        if (ele == c_empty) {
-
-            m_pointScores[black][horizontal][r][ct] = calculateScore(r, ct, black, horizontal);
-            m_pointScores[white][horizontal][r][ct] = calculateScore(r, ct, white, horizontal);
-
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
-
-            m_totalScore[ele] -= m_pointScores[ele][horizontal][r][ct];
-            m_totalScore[ele] += (m_pointScores[ele][horizontal][r][ct] = calculateScore(r, ct, ele, horizontal));
-
-        }
-    }
-    if (chess == c_empty) {
-        if (m_win && count[prev] < 4)
-            m_win = false;
-    } else if (count[chess] >= 4) {
-        m_win = true;
-    }
-
-    // Update vertically
-    count[0] = count[1] = flag[0] = flag[1] = false;
-    for (int rt = r - 1; rt >= max(0, r - SCORE_RANGE); rt--) {
-        IN_RANGE(rt, c);
-        auto ele = m_board[rt][c];
-        if (ele == c_empty) {
-
-            m_pointScores[black][vertical][rt][c] = calculateScore(rt, c, black, vertical);
-            m_pointScores[white][vertical][rt][c] = calculateScore(rt, c, white, vertical);
-
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
-
-            m_totalScore[ele] -= m_pointScores[ele][vertical][rt][c];
-            m_totalScore[ele] += (m_pointScores[ele][vertical][rt][c] = calculateScore(rt, c, ele, vertical));
-
+        // chess -> empty: Revert score @ (x, y), then rescan it for both players
+        m_state.totalScore[prev] -= getScore(r, c, prev);
+        for (int dir = 0; dir < 4; ++dir) {
+            scores[black][idx][dir] = calculateScore(idx, black, static_cast<Direction>(dir));
+            scores[white][idx][dir] = calculateScore(idx, white, static_cast<Direction>(dir));
         }
     }
-    flag[0] = flag[1] = false;
-    for (int rt = r + 1; rt < min(BOARD_SIZE, r + SCORE_RANGE); rt++) {
-        IN_RANGE(rt, c);
-        auto ele = m_board[rt][c];
-        if (ele == c_empty) {
-
-            m_pointScores[black][vertical][rt][c] = calculateScore(rt, c, black, vertical);
-            m_pointScores[white][vertical][rt][c] = calculateScore(rt, c, white, vertical);
 
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
+    for (int dir = 0; dir < 4; ++dir) {
+        // Stones of the new chess in a row through (x, y)
+        int count = 1;
 
-            m_totalScore[ele] -= m_pointScores[ele][vertical][rt][c];
-            m_totalScore[ele] += (m_pointScores[ele][vertical][rt][c] = calculateScore(rt, c, ele, vertical));
+        // Walk backward, then forward, stopping at the border
+        for (int side = 0; side < 2; ++side) {
+            const int step = side ? DIR_STEP[dir] : -DIR_STEP[dir];
+            bool inRow = chess != c_empty;
+            for (int t = 1, i = idx + step; t <= UPDATE_RANGE; t++, i += step) {
+                auto ele = m_state.cells[i];
+                if (ele == c_empty) {
+                    inRow = false;
 
-        }
-    }
-    if (chess == c_empty) {
-        if (m_win && count[prev] < 4)
-            m_win = false;
-    } else if (count[chess] >= 4) {
-        m_win = true;
-    }
+                    scores[black][i][dir] = calculateScore(i, black, static_cast<Direction>(dir));
+                    scores[white][i][dir] = calculateScore(i, white, static_cast<Direction>(dir));
 
-    // Update diagonally (LU -> RD)
-    count[0] = count[1] = flag[0] = flag[1] = false;
-    for (int t = 1;
-         (c - t >= max(0, c - SCORE_RANGE)) && (r - t >= max(0, r - SCORE_RANGE));
-         t++) {
-        int rt = r - t, ct = c - t;
-        IN_RANGE(rt, ct);
-        auto ele = m_board[rt][ct];
-        if (ele == c_empty) {
+                } else if (ele == c_edge) {
+                    break;
+                } else {
+                    if (inRow && ele == chess) count++;
+                    else inRow = false;
 
-            m_pointScores[black][diag_LU][rt][ct] = calculateScore(rt, ct, black, diag_LU);
-            m_pointScores[white][diag_LU][rt][ct] = calculateScore(rt, ct, white, diag_LU);
+                    auto &code = scores[ele][i][dir];
+                    m_state.totalScore[ele] -= m_weights->weights[code];
+                    code = calculateScore(i, ele, static_cast<Direction>(dir));
+                    m_state.totalScore[ele] += m_weights->weights[code];
 
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
+                }
             }
-
-            m_totalScore[ele] -= m_pointScores[ele][diag_LU][rt][ct];
-            m_totalScore[ele] += (m_pointScores[ele][diag_LU][rt][ct] = calculateScore(rt, ct, ele, diag_LU));
-
         }
-    }
-    flag[0] = flag[1] = false;
-    for (int t = 1;
-         (c + t < min(BOARD_SIZE, c + SCORE_RANGE)) && (r + t < min(BOARD_SIZE, r + SCORE_RANGE));
-         t++) {
-        int rt = r + t, ct = c + t;
-        IN_RANGE(rt, ct);
-        auto ele = m_board[rt][ct];
-        if (ele == c_empty) {
-
-            m_pointScores[black][diag_LU][rt][ct] = calculateScore(rt, ct, black, diag_LU);
-            m_pointScores[white][diag_LU][rt][ct] = calculateScore(rt, ct, white, diag_LU);
 
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
-
-            m_totalScore[ele] -= m_pointScores[ele][diag_LU][rt][ct];
-            m_totalScore[ele] += (m_pointScores[ele][diag_LU][rt][ct] = calculateScore(rt, ct, ele, diag_LU));
-
-        }
-    }
-    if (chess == c_empty) {
-        if (m_win && count[prev] < 4)
-            m_win = false;
-    } else if (count[chess] >= 4) {
-        m_win = true;
+        if (chess != c_empty && count >= 5)
+            m_state.win = true;
     }
 
-    // Update diagonally (RU -> LD)
-    count[0] = count[1] = flag[0] = flag[1] = false;
-    for (int t = 1;
-         (c + t < min(BOARD_SIZE, c + SCORE_RANGE)) && (r - t >= max(0, r - SCORE_RANGE));
-         t++) {
-        int rt = r - t, ct = c + t;
-        IN_RANGE(rt, ct);
-        auto ele = m_board[rt][ct];
-        if (ele == c_empty) {
-
-            m_pointScores[black][diag_RU][rt][ct] = calculateScore(rt, ct, black, diag_RU);
-            m_pointScores[white][diag_RU][rt][ct] = calculateScore(rt, ct, white, diag_RU);
-
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
-
-            m_totalScore[ele] -= m_pointScores[ele][diag_RU][rt][ct];
-            m_totalScore[ele] += (m_pointScores[ele][diag_RU][rt][ct] = calculateScore(rt, ct, ele, diag_RU));
-
-        }
-    }
-    flag[0] = flag[1] = false;
-    for (int t = 1;
-         (c - t >= max(0, c - SCORE_RANGE)) && (r + t < min(BOARD_SIZE, r + SCORE_RANGE));
-         t++) {
-        int rt = r + t, ct = c - t;
-        IN_RANGE(rt, ct);
-        auto ele = m_board[rt][ct];
-        if (ele == c_empty) {
-
-            m_pointScores[black][diag_RU][rt][ct] = calculateScore(rt, ct, black, diag_RU);
-            m_pointScores[white][diag_RU][rt][ct] = calculateScore(rt, ct, white, diag_RU);
-
-        } else {
-            for (int i = 0; i < 2; ++i) {
-                if (!flag[i] && ele == i)
-                    count[i]++;
-                else
-                    flag[i] = true;
-            }
-
-            m_totalScore[ele] -= m_pointScores[ele][diag_RU][rt][ct];
-            m_totalScore[ele] += (m_pointScores[ele][diag_RU][rt][ct] = calculateScore(rt, ct, ele, diag_RU));
-
-        }
-    }
-    if (chess == c_empty) {
-        if (m_win && count[prev] < 4)
-            m_win = false;
-    } else if (count[chess] >= 4) {
-        m_win = true;
-    }
+    // A removed stone may leave another five on board
+    if (chess == c_empty && m_state.win)
+        m_state.win = hasFive();
 }
 
-Forms Board::calculateScore(int r, int c, Chess chess, Direction dir) const {
+template<int Size>
+Pattern BasicBoard<Size>::calculateScore(int idx, Chess chess, Direction dir) const {
+    PROFILE_SCOPE(ps_calculateScore);
+    const Chess *cells = m_state.cells;
+    const int step = DIR_STEP[dir];
     int count = 1;
     int block = 0;
     int emptyPos = -1;
 
-    switch (dir) {
-        case horizontal: {
-            // Left
-            for (int ct = c - 1; ct >= c - SCORE_RANGE; ct--) {
-                if (ct < 0) {
-                    block++;
-                    break;
-                }
-                IN_RANGE(r, ct);
-                auto ele = m_board[r][ct];
-                if (ele == chess) {
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && ct > 0 && m_board[r][ct - 1] == chess)
-                        emptyPos = count;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
-
-            // Right
-            for (int ct = c + 1; ct <= c + SCORE_RANGE; ct++) {
-                if (ct >= BOARD_SIZE) {
-                    block++;
-                    break;
-                }
-                IN_RANGE(r, ct);
-                auto ele = m_board[r][ct];
-                if (ele == chess) {
-                    if (emptyPos != -1) emptyPos++;
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && ct < BOARD_SIZE - 1 && m_board[r][ct + 1] == chess)
-                        emptyPos = 0;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
-            break;
-        }
-        case vertical: {
-            // Up
-            for (int rt = r - 1; rt >= r - SCORE_RANGE; rt--) {
-                if (rt < 0) {
-                    block++;
-                    break;
-                }
-                IN_RANGE(rt, c);
-                auto ele = m_board[rt][c];
-                if (ele == chess) {
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && rt > 0 && m_board[rt - 1][c] == chess)
-                        emptyPos = count;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
-
-            // Down
-            for (int rt = r + 1; rt <= r + SCORE_RANGE; rt++) {
-                if (rt >= BOARD_SIZE) {
-                    block++;
-                    break;
-                }
-                IN_RANGE(rt, c);
-                auto ele = m_board[rt][c];
-                if (ele == chess) {
-                    if (emptyPos != -1) emptyPos++;
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && rt < BOARD_SIZE - 1 && m_board[rt + 1][c] == chess)
-                        emptyPos = 0;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
-            break;
-        }
-        case diag_LU: {
-            // LU
-            for (int t = 1; t <= SCORE_RANGE; t++) {
-                int rt = r - t, ct = c - t;
-                if (rt < 0 || ct < 0) {
-                    block++;
-                    break;
-                }
-
-                IN_RANGE(rt, ct);
-                auto ele = m_board[rt][ct];
-
-                if (ele == chess) {
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && (ct > 0 && rt > 0) && m_board[rt - 1][ct - 1] == chess)
-                        emptyPos = count;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
-
-            // RD
-            for (int t = 1; t <= SCORE_RANGE; t++) {
-                int rt = r + t, ct = c + t;
-                if (rt >= BOARD_SIZE || ct >= BOARD_SIZE) {
-                    block++;
-                    break;
-                }
-
-                IN_RANGE(rt, ct);
-                auto ele = m_board[rt][ct];
-                if (ele == chess) {
-                    if (emptyPos != -1) emptyPos++;
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && (ct + 1 < BOARD_SIZE && rt + 1 < BOARD_SIZE) &&
-                        m_board[rt + 1][ct + 1] == chess)
-                        emptyPos = 0;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
+    // Backward (left / up), the border counts as a block
+    for (int t = 1, i = idx - step; t <= SCORE_RANGE; t++, i -= step) {
+        auto ele = cells[i];
+        if (ele == chess) {
+            count++;
+        } else if (ele == c_empty) {
+            if (emptyPos == -1 && cells[i - step] == chess)
+                emptyPos = count;
+            else break;
+        } else {
+            block++;
             break;
         }
-        case diag_RU: {
-            // RU
-            for (int t = 1; t <= SCORE_RANGE; t++) {
-                int rt = r - t, ct = c + t;
-                if (rt < 0 || ct >= BOARD_SIZE) {
-                    block++;
-                    break;
-                }
-
-                IN_RANGE(rt, ct);
-                auto ele = m_board[rt][ct];
-
-                if (ele == chess) {
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && (ct + 1 < BOARD_SIZE && rt > 0) &&
-                        m_board[rt - 1][ct + 1] == chess)
-                        emptyPos = count;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
-
-            // LD
-            for (int t = 1; t <= SCORE_RANGE; t++) {
-                int rt = r + t, ct = c - t;
-                if (ct < 0 || rt >= BOARD_SIZE) {
-                    block++;
-                    break;
-                }
+    }
 
-                IN_RANGE(rt, ct);
-                auto ele = m_board[rt][ct];
-                if (ele == chess) {
-                    if (emptyPos != -1) emptyPos++;
-                    count++;
-                } else if (ele == c_empty) {
-                    if (emptyPos == -1 && (ct > 0 && rt + 1 < BOARD_SIZE) &&
-                        m_board[rt + 1][ct - 1] == chess)
-                        emptyPos = 0;
-                    else break;
-                } else {
-                    block++;
-                    break;
-                }
-            }
+    // Forward (right / down)
+    for (int t = 1, i = idx + step; t <= SCORE_RANGE; t++, i += step) {
+        auto ele = cells[i];
+        if (ele == chess) {
+            if (emptyPos != -1) emptyPos++;
+            count++;
+        } else if (ele == c_empty) {
+            if (emptyPos == -1 && cells[i + step] == chess)
+                emptyPos = 0;
+            else break;
+        } else {
+            block++;
             break;
         }
     }
@@ -895,116 +633,135 @@ Forms Board::calculateScore(int r, int c, Chess chess, Direction dir) const {
 #pragma clang diagnostic push
 #pragma ide diagnostic ignored "hicpp-multiway-paths-covered"
 
-Forms Board::matchForm(int count, int block, int emptyPos) {
+template<int Size>
+bool BasicBoard<Size>::hasFive() const {
+    for (int r = 0; r < BOARD_SIZE; ++r) {
+        for (int c = 0; c < BOARD_SIZE; ++c) {
+            const int idx = index(r, c);
+            if (m_state.cells[idx] == c_empty) continue;
+            for (int step : DIR_STEP) {
+                // Only count from the first stone of a run
+                if (m_state.cells[idx - step] == m_state.cells[idx]) continue;
+                int count = 1;
+                while (m_state.cells[idx + count * step] == m_state.cells[idx]) count++;
+                if (count >= 5) return true;
+            }
+        }
+    }
+    return false;
+}
+
+template<int Size>
+Pattern BasicBoard<Size>::matchForm(int count, int block, int emptyPos) {
     if (emptyPos <= 0) {
         if (count >= 5)
-            return _5;
+            return p_5;
         if (block == 0) {
             switch (count) {
                 case 1:
-                    return _1p;
+                    return p_1p;
                 case 2:
-                    return _2p;
+                    return p_2p;
                 case 3:
-                    return _3p;
+                    return p_3p;
                 case 4:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 1) {
             switch (count) {
                 case 1:
-                    return _1m;
+                    return p_1m;
                 case 2:
-                    return _2m;
+                    return p_2m;
                 case 3:
-                    return _3m;
+                    return p_3m;
                 case 4:
-                    return _4m;
+                    return p_4m;
             }
         }
     } else if (emptyPos == 1 || emptyPos == count - 1) {
         // Empty on the first position
         if (count >= 6)
-            return _5;
+            return p_5;
         if (block == 0) {
             switch (count) {
                 case 2:
                     // return _2p / 2;
-                    return _2p_spaced;
+                    return p_2p_spaced;
                 case 3:
-                    return _3p;
+                    return p_3p;
                 case 4:
-                    return _4m;
+                    return p_4m;
                 case 5:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 1) {
             switch (count) {
                 case 2:
-                    return _2m;
+                    return p_2m;
                 case 3:
-                    return _3m;
+                    return p_3m;
                 case 4:
                 case 5:
-                    return _4m;
+                    return p_4m;
             }
         }
 
     } else if (emptyPos == 2 || emptyPos == count - 2) {
         // Empty on the second position
         if (count >= 7)
-            return _5;
+            return p_5;
         if (block == 0) {
             switch (count) {
                 case 3:
-                    return _3p;
+                    return p_3p;
                 case 4:
                 case 5:
-                    return _4m;
+                    return p_4m;
                 case 6:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 1) {
             switch (count) {
                 case 3:
-                    return _3m;
+                    return p_3m;
                 case 4:
                 case 5:
-                    return _4m;
+                    return p_4m;
                 case 6:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 2) {
             switch (count) {
                 case 4:
                 case 5:
                 case 6:
-                    return _4m;
+                    return p_4m;
             }
         }
 
     } else if (emptyPos == 3 || emptyPos == count - 3) {
         // Empty on the third position
         if (count >= 8)
-            return _5;
+            return p_5;
         if (block == 0) {
             switch (count) {
                 case 4:
                 case 5:
-                    return _3p;
+                    return p_3p;
                 case 6:
-                    return _4m;
+                    return p_4m;
                 case 7:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 1) {
             switch (count) {
                 case 4:
                 case 5:
                 case 6:
-                    return _4m;
+                    return p_4m;
                 case 7:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 2) {
             switch (count) {
@@ -1012,20 +769,20 @@ Forms Board::matchForm(int count, int block, int emptyPos) {
                 case 5:
                 case 6:
                 case 7:
-                    return _4m;
+                    return p_4m;
             }
         }
     } else if (emptyPos == 4 || emptyPos == count - 4) {
         // Empty on the fourth position
         if (count > 9)
-            return _5;
+            return p_5;
         if (block == 0) {
             switch (count) {
                 case 5:
                 case 6:
                 case 7:
                 case 8:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 1) {
             switch (count) {
@@ -1033,9 +790,9 @@ Forms Board::matchForm(int count, int block, int emptyPos) {
                 case 5:
                 case 6:
                 case 7:
-                    return _4m;
+                    return p_4m;
                 case 8:
-                    return _4p;
+                    return p_4p;
             }
         } else if (block == 2) {
             switch (count) {
@@ -1043,12 +800,66 @@ Forms Board::matchForm(int count, int block, int emptyPos) {
                 case 6:
                 case 7:
                 case 8:
-                    return _4m;
+                    return p_4m;
             }
         }
     } else if (emptyPos == 5 || emptyPos == count - 5)
-        return _5;
-    return _empty;
+        return p_5;
+    return p_empty;
 }
 
 #pragma clang diagnostic pop
+
+template class BasicBoard<15>;
+template class BasicBoard<19>;
+template class BasicBoard<20>;
+
+/* Search context */
+
+template<int Size>
+void BasicSearchContext<Size>::cache(const BasicBoard<Size> &board, Chess player, int score, int depth, Coord move) {
+    PROFILE_SCOPE(ps_cache);
+    // Moves are kept on the board the hash was taken from, so that they apply to every symmetric position
+    int sym = board.getHashSymmetry();
+    if (move.x >= 0 && sym != 0) move = BasicBoard<Size>::transform(sym, move.x, move.y);
+    if (m_table != nullptr) {
+        assert(m_table->getSeed() == board.getSeed());
+        m_table->store(board.cacheKey(player), score, depth, move);
+        return;
+    }
+    // Keep the deepest result
+    auto res = m_cache.try_emplace(board.cacheKey(player), CacheData{score, depth, move});
+    if (!res.second && res.first->second.depth <= depth)
+        res.first->second = CacheData{score, depth, move};
+}
+
+template<int Size>
+bool BasicSearchContext<Size>::getCache(const BasicBoard<Size> &board, Chess player, CacheData &out) const {
+    PROFILE_SCOPE(ps_getCache);
+    if (m_table != nullptr) {
+        if (!m_table->probe(board.cacheKey(player), out)) return false;
+    } else {
+        auto it = m_cache.find(board.cacheKey(player));
+        if (it == m_cache.end())
+            return false;
+        out = it->second;
+    }
+    int sym = board.getHashSymmetry();
+    if (out.move.x >= 0 && sym != 0) out.move = BasicBoard<Size>::inverseTransform(sym, out.move.x, out.move.y);
+    return true;
+}
+
+template<int Size>
+void BasicSearchContext<Size>::setTable(TranspositionTable *table) {
+    assert(table == nullptr || table->isOpen());
+    m_table = table;
+}
+
+template<int Size>
+unsigned long BasicSearchContext<Size>::getCachedSize() const {
+    return m_cache.size() * sizeof(CacheData);
+}
+
+template class BasicSearchContext<15>;
+template class BasicSearchContext<19>;
+template class BasicSearchContext<20>;
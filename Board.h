@@ -4,16 +4,79 @@
 #include <string>
 #include <vector>
 #include <unordered_map>
+#include <type_traits>
 #include "constants.h"
+#include "TranspositionTable.h"
 
+struct PatternLUT;
 
-class Board {
+/*
+ * Position data, kept trivially copyable so that a board can be cloned cheaply.
+ * Cells are linearized with ROW_STRIDE cells per row. The spare cells of each row and the rows around the board
+ * hold c_edge, so scans stop at the border without bounds checks; the two rows on top keep rows 64-byte aligned.
+ */
+template<int Size>
+struct BoardState {
+    static constexpr int ROW_STRIDE = rowStride(Size);
+    static constexpr int CELLS = (Size + 3) * ROW_STRIDE;
+
+    static constexpr int index(int r, int c) { return (r + 2) * ROW_STRIDE + c; }
+
+    Chess cells[CELLS];
+    unsigned char neighborCount[2][Size][Size];
+    int numChess;
+    bool win;
+
+    // Scores
+    int totalScore[2];
+    // [player][cell][dir], a row of a 15x15 board fills one cache line
+    alignas(64) Pattern pointScores[2][CELLS][4];
+
+    // Zobrist code of the board seen through each symmetry (see BasicBoard::transform), only the
+    // positional one at index 0 is maintained unless canonicalHash is set
+    long zobristCode[8];
+    bool canonicalHash;
+};
+
+static_assert(std::is_trivially_copyable<BoardState<BOARD_SIZE>>::value, "BoardState must stay trivially copyable");
+
+// Scratch buffers of Board::heuristicGenerator, each search owns its own (see BasicSearchContext).
+// Every list is sized for the whole board, since concat() may merge several of them into one.
+template<int Size>
+struct GeneratorContext {
+    Point ai_5[Size * Size], op_5[Size * Size],
+            ai_4p[Size * Size], op_4p[Size * Size],
+            ai_combo[Size * Size], op_combo[Size * Size],
+            ai_double3[Size * Size], op_double3[Size * Size],
+            ai_4m[Size * Size], op_4m[Size * Size],
+            ai_3p[Size * Size], op_3p[Size * Size],
+            ai_2p[Size * Size], op_2p[Size * Size],
+            neighbor[Size * Size];
+    // Most candidates returned for a position without threes or fours
+    int candidateLimit = 20;
+};
+
+/*
+ * A board of Size x Size, instantiated for 15 (Botzone), 19 and 20 (Gomocup).
+ * BOARD_SIZE and ROW_STRIDE are shadowed inside the class, so the loop bounds are compile-time constants.
+ */
+template<int Size>
+class BasicBoard {
 public:
-    Board();
+    static constexpr int BOARD_SIZE = Size;
+    static constexpr int ROW_STRIDE = rowStride(Size);
+
+    BasicBoard();
+
+    // Zobrist codes drawn from seed, so that runs with the same seed search the same trees
+    explicit BasicBoard(unsigned long seed);
 
     /* Mutators */
     void set(int r, int c, Chess player);
 
+    // Replace the stones by moves, black first then alternating, computing the state once at the end
+    void load(const std::vector<Coord> &moves);
+
     /* Accessors */
     [[nodiscard]] int getScore(Chess player) const;
 
@@ -27,52 +90,113 @@ public:
 
     [[nodiscard]] bool hasNeighbor(int r, int c, int range, int count) const;
 
-    /* Heuristic */
-    Point *heuristicGenerator(Chess player, Chess ai_id, int &resSize, bool checkmateOnly, bool do_sort);
+    // Pattern chess would form at (r, c) along dir, computed from the cells rather than read from the state
+    [[nodiscard]] Pattern getPattern(int r, int c, Chess chess, Direction dir) const;
 
-    /* Cache */
-    void cache(int score, int depth);
+    /* Heuristic */
+    Point *heuristicGenerator(GeneratorContext<Size> &ctx, Chess player, Chess ai_id, int &resSize, bool checkmateOnly,
+                              bool do_sort) const;
 
-    [[nodiscard]] CacheData *getCache() const;
+    [[nodiscard]] unsigned long getSeed() const;
 
-    [[nodiscard]] unsigned long getCachedSize() const;
+    // Key of the position with player to move in a cache, taken from getHash()
+    [[nodiscard]] long cacheKey(Chess player) const;
 
     std::string to_string(std::vector<Point *> *planned = nullptr);
 
-private:
-    // Board
-    Chess m_board[BOARD_SIZE][BOARD_SIZE]{};
-    int m_neighborCount[2][BOARD_SIZE][BOARD_SIZE]{};
-    int m_numChess = 0;
-    bool m_win = false;
+    /* Symmetry */
+    // Maps (r, c) through one of the 8 symmetries of the square: identity, 3 rotations, 4 reflections
+    static Coord transform(int sym, int r, int c);
 
-    // Scores
-    int m_totalScore[2]{};
-    Forms m_pointScores[2][4][BOARD_SIZE][BOARD_SIZE]{};
+    static Coord inverseTransform(int sym, int r, int c);
+
+    // Key the cache by the smallest code among the 8 symmetric boards, so that transpositions share entries
+    void setCanonicalHashing(bool enabled);
+
+    [[nodiscard]] long getHash() const;
+
+    // The symmetry that maps this board onto the one its hash was taken from
+    [[nodiscard]] int getHashSymmetry() const;
+
+    /* Evaluation */
+    // Weigh the patterns with weights instead of PATTERN_SCORE, which must outlive the board. Recomputes the scores
+    void setWeights(const PatternLUT *weights);
+
+    // Number of stone and direction pairs of player holding each pattern, getScore(player) is their weighted sum
+    void countPatterns(Chess player, int counts[PATTERN_COUNT]) const;
 
-    // Caches
-    long m_zobristCode;
+    /* State */
+    [[nodiscard]] const BoardState<Size> &getState() const;
+
+    // The scores of state must come from the weights of this board
+    void setState(const BoardState<Size> &state);
+
+    // Recompute the incrementally maintained state from the cells, returns the first mismatch or "" if there is none
+    [[nodiscard]] std::string checkState() const;
+
+private:
+    BoardState<Size> m_state{};
+
+    // Zobrist codes
     long m_zobristTable[2][BOARD_SIZE][BOARD_SIZE]{};
-    std::unordered_map<long, CacheData *> m_cache;
-
-    // Heuristic
-    Point ai_5[BOARD_SIZE * BOARD_SIZE / 3], op_5[BOARD_SIZE * BOARD_SIZE / 3],
-            ai_4p[BOARD_SIZE * BOARD_SIZE / 3], op_4p[BOARD_SIZE * BOARD_SIZE / 3],
-            ai_combo[BOARD_SIZE * BOARD_SIZE / 3], op_combo[BOARD_SIZE * BOARD_SIZE / 3],
-            ai_double3[BOARD_SIZE * BOARD_SIZE / 3], op_double3[BOARD_SIZE * BOARD_SIZE / 3],
-            ai_4m[BOARD_SIZE * BOARD_SIZE / 3], op_4m[BOARD_SIZE * BOARD_SIZE / 3],
-            ai_3p[BOARD_SIZE * BOARD_SIZE / 3], op_3p[BOARD_SIZE * BOARD_SIZE / 3],
-            ai_2p[BOARD_SIZE * BOARD_SIZE / 3], op_2p[BOARD_SIZE * BOARD_SIZE / 3],
-            neighbor[BOARD_SIZE * BOARD_SIZE / 3], res_point[BOARD_SIZE * BOARD_SIZE / 3];
+    long m_zobristTurn{};
+    // Code of the empty board
+    long m_zobristEmpty{};
+    unsigned long m_seed;
+    const PatternLUT *m_weights;
+
+    // Index step of each Direction in the padded layout
+    static constexpr int DIR_STEP[4] = {ROW_STRIDE, 1, ROW_STRIDE + 1, ROW_STRIDE - 1};
+    // How far updateGrid rescans on each side of the changed cell: calculateScore looks SCORE_RANGE cells away,
+    // then peeks one further for a spaced stone
+    static constexpr int UPDATE_RANGE = SCORE_RANGE + 1;
+
+    static constexpr int index(int r, int c) { return BoardState<Size>::index(r, c); }
+
+    // Recompute the state from the cells
+    void rebuild();
 
     void updateNeighbor(int r, int c);
 
     void updateGrid(int r, int c, Chess prev);
 
-    [[nodiscard]] Forms calculateScore(int r, int c, Chess chess, Direction dir) const;
+    [[nodiscard]] Pattern calculateScore(int idx, Chess chess, Direction dir) const;
+
+    // Whether five or more stones of a color stand in a row, scanning the whole board
+    [[nodiscard]] bool hasFive() const;
 
-    static Forms matchForm(int count, int block, int emptyPos);
+    static Pattern matchForm(int count, int block, int emptyPos);
 };
 
+using Board = BasicBoard<BOARD_SIZE>;
+
+/*
+ * The state a search changes beside the board: the generator scratch and the cache of scores. The cache is keyed by
+ * position and side to move, scores are relative to the side to move, so they do not depend on the side searching:
+ * the searchers of both sides of a board may share a context and reuse each other's entries. A context serves one
+ * search at a time.
+ */
+template<int Size>
+class BasicSearchContext {
+public:
+    GeneratorContext<Size> generator;
+
+    void cache(const BasicBoard<Size> &board, Chess player, int score, int depth, Coord move = Coord());
+
+    // Returns false if the position is not cached
+    [[nodiscard]] bool getCache(const BasicBoard<Size> &board, Chess player, CacheData &out) const;
+
+    // Cache in table instead of the in-memory map, nullptr switches back. The table must use the seed of the boards
+    void setTable(TranspositionTable *table);
+
+    [[nodiscard]] unsigned long getCachedSize() const;
+
+private:
+    std::unordered_map<long, CacheData> m_cache;
+    TranspositionTable *m_table = nullptr;
+};
+
+using SearchContext = BasicSearchContext<BOARD_SIZE>;
+
 
 #endif //GOMOKU_BOARD_H
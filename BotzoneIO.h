@@ -0,0 +1,187 @@
+#ifndef GOMOKU_BOTZONEIO_H
+#define GOMOKU_BOTZONEIO_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "constants.h"
+
+// Moves of one Botzone input, oldest first
+struct BotzoneInput {
+    // Whether the input held the "requests" / "responses" history, or a bare request of the long-running mode
+    bool full = false;
+    // Moves of the opponent, (-1, -1) for the first request of black, then the moves of this bot
+    std::vector<Coord> requests, responses;
+};
+
+/*
+ * Reads a Botzone input line in place, without building a DOM: {"requests": [...], "responses": [...], ...} or
+ * {"x": .., "y": ..}. Fields other than the moves are skipped.
+ */
+class BotzoneReader {
+public:
+    BotzoneReader(const char *begin, const char *end) : m_p(begin), m_end(end) {}
+
+    // Returns false on input this reader does not understand
+    bool read(BotzoneInput &input) {
+        input.full = false;
+        input.requests.clear();
+        input.responses.clear();
+
+        Coord bare;
+        bool hasX = false, hasY = false;
+        if (!consume('{')) return false;
+        if (consume('}')) return false;
+        do {
+            const char *key;
+            int len;
+            if (!readKey(key, len)) return false;
+            if (isKey(key, len, "requests") || isKey(key, len, "responses")) {
+                input.full = true;
+                if (!readMoves(key[2] == 'q' ? input.requests : input.responses)) return false;
+            } else if (isKey(key, len, "x") || isKey(key, len, "y")) {
+                int v;
+                if (!readInt(v)) return false;
+                (key[0] == 'x' ? bare.x : bare.y) = static_cast<short>(v);
+                (key[0] == 'x' ? hasX : hasY) = true;
+            } else if (!skipValue(0)) return false;
+        } while (consume(','));
+        if (!consume('}')) return false;
+
+        if (input.full) return !input.requests.empty();
+        if (!hasX || !hasY) return false;
+        input.requests.push_back(bare);
+        return true;
+    }
+
+private:
+    const char *m_p, *m_end;
+
+    static bool isKey(const char *key, int len, const char *name) {
+        return len == (int) strlen(name) && !memcmp(key, name, len);
+    }
+
+    static bool isSpace(char c) { return c == ' ' || c == '\t' || c == '\r' || c == '\n'; }
+
+    void skipSpace() {
+        while (m_p != m_end && isSpace(*m_p)) m_p++;
+    }
+
+    bool consume(char c) {
+        skipSpace();
+        if (m_p == m_end || *m_p != c) return false;
+        m_p++;
+        return true;
+    }
+
+    // A string, returned as the raw bytes between the quotes
+    bool readString(const char *&str, int &len) {
+        if (!consume('"')) return false;
+        str = m_p;
+        for (; m_p != m_end && *m_p != '"'; m_p++)
+            if (*m_p == '\\' && ++m_p == m_end) return false;
+        if (m_p == m_end) return false;
+        len = static_cast<int>(m_p++ - str);
+        return true;
+    }
+
+    bool readKey(const char *&key, int &len) {
+        return readString(key, len) && consume(':');
+    }
+
+    bool readInt(int &v) {
+        skipSpace();
+        bool negative = m_p != m_end && *m_p == '-';
+        if (negative) m_p++;
+        if (m_p == m_end || *m_p < '0' || *m_p > '9') return false;
+        for (v = 0; m_p != m_end && *m_p >= '0' && *m_p <= '9'; m_p++) v = v * 10 + (*m_p - '0');
+        if (negative) v = -v;
+        return true;
+    }
+
+    // {"x": .., "y": ..}
+    bool readMove(Coord &move) {
+        bool hasX = false, hasY = false;
+        if (!consume('{')) return false;
+        do {
+            const char *key;
+            int len, v;
+            if (!readKey(key, len)) return false;
+            if (isKey(key, len, "x") || isKey(key, len, "y")) {
+                if (!readInt(v)) return false;
+                (key[0] == 'x' ? move.x : move.y) = static_cast<short>(v);
+                (key[0] == 'x' ? hasX : hasY) = true;
+            } else if (!skipValue(0)) return false;
+        } while (consume(','));
+        return consume('}') && hasX && hasY;
+    }
+
+    bool readMoves(std::vector<Coord> &moves) {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do {
+            Coord move;
+            if (!readMove(move)) return false;
+            moves.push_back(move);
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool skipValue(int depth) {
+        if (depth > 32) return false;
+        skipSpace();
+        if (m_p == m_end) return false;
+        const char *str;
+        int len;
+        switch (*m_p) {
+            case '"':
+                return readString(str, len);
+            case '{':
+                m_p++;
+                if (consume('}')) return true;
+                do {
+                    if (!readKey(str, len) || !skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume('}');
+            case '[':
+                m_p++;
+                if (consume(']')) return true;
+                do {
+                    if (!skipValue(depth + 1)) return false;
+                } while (consume(','));
+                return consume(']');
+            default:
+                // Numbers, true, false, null
+                const char *start = m_p;
+                while (m_p != m_end && *m_p != ',' && *m_p != '}' && *m_p != ']' && !isSpace(*m_p)) m_p++;
+                return m_p != start;
+        }
+    }
+};
+
+/*
+ * Writes {"response": {"x": .., "y": ..}, "debug": {"_b": .., "_w": .., "msg": ".."}} and a newline to out with a
+ * single fwrite.
+ */
+inline void writeBotzoneResponse(FILE *out, int x, int y, int blackScore, int whiteScore, const std::string &msg) {
+    std::string buff;
+    buff.reserve(96 + msg.size());
+    char head[96];
+    snprintf(head, sizeof(head), R"({"response":{"x":%d,"y":%d},"debug":{"_b":%d,"_w":%d,"msg":")", x, y,
+             blackScore, whiteScore);
+    buff += head;
+    for (char c : msg) {
+        if (c == '"' || c == '\\') buff += '\\';
+        if ((unsigned char) c < 0x20) {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            buff += escaped;
+        } else buff += c;
+    }
+    buff += "\"}}\n";
+    fwrite(buff.data(), 1, buff.size(), out);
+}
+
+
+#endif //GOMOKU_BOTZONEIO_H
@@ -0,0 +1,192 @@
+#include "GameRecord.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+static constexpr char MAGIC[8] = {'G', 'M', 'K', '-', 'R', 'E', 'C', '\0'};
+static constexpr uint32_t VERSION = 1;
+// Magic, version, board size, rule and 2 reserved bytes
+static constexpr size_t FILE_HEADER = 16;
+// Move count, winner and flags
+static constexpr size_t GAME_HEADER = 4;
+static constexpr uint8_t FLAG_INFO = 1;
+
+static int moveBytes(int boardSize) {
+    return boardSize * boardSize > 255 ? 2 : 1;
+}
+
+static string fileHeader(int boardSize, GameRule rule) {
+    string res(MAGIC, sizeof(MAGIC));
+    for (int i = 0; i < 4; ++i) res += (char) (VERSION >> (8 * i));
+    res += (char) boardSize;
+    res += (char) rule;
+    res += string(2, '\0');
+    return res;
+}
+
+/* Writer */
+
+// Exclusive flock on the file for the scope, held by every writer while it truncates or appends
+struct FileLock {
+    int fd;
+
+    explicit FileLock(FILE *file) : fd(fileno(file)) { flock(fd, LOCK_EX); }
+
+    ~FileLock() { flock(fd, LOCK_UN); }
+};
+
+GameRecordWriter::~GameRecordWriter() {
+    close();
+}
+
+bool GameRecordWriter::open(const string &path, int boardSize, GameRule rule) {
+    close();
+    m_file = fopen(path.c_str(), "a+b");
+    if (m_file == nullptr) return false;
+
+    auto header = fileHeader(boardSize, rule);
+    bool ok = true;
+    {
+        // Other writers wait, so a partial tail is a game cut off and not one being appended
+        FileLock lock(m_file);
+        // Drop a game cut off by a crash, the next ones would be read as part of it
+        size_t end = 0, size = 0;
+        {
+            GameRecordReader reader;
+            if (reader.open(path)) {
+                size_t offset = reader.begin();
+                GameView game;
+                end = offset;
+                while (reader.next(offset, game)) end = offset;
+                size = reader.size();
+            }
+        }
+        if (end != size) ok = ftruncate(fileno(m_file), (off_t) end) == 0;
+
+        // An existing file must be of the same board and rule
+        char existing[FILE_HEADER];
+        rewind(m_file);
+        size_t n = ok ? fread(existing, 1, FILE_HEADER, m_file) : 0;
+        if (ok && n == 0) {
+            fseek(m_file, 0, SEEK_END);
+            ok = fwrite(header.data(), 1, header.size(), m_file) == header.size();
+            ok = fflush(m_file) == 0 && ok;
+        } else if (ok) ok = n == FILE_HEADER && memcmp(existing, header.data(), FILE_HEADER) == 0;
+    }
+    if (!ok) {
+        close();
+        return false;
+    }
+    m_boardSize = boardSize;
+    return true;
+}
+
+void GameRecordWriter::close() {
+    if (m_file == nullptr) return;
+    fclose(m_file);
+    m_file = nullptr;
+}
+
+bool GameRecordWriter::write(const vector<Coord> &moves, Chess winner, const vector<MoveInfo> &info) {
+    if (m_file == nullptr || moves.size() > 0xFFFF || (!info.empty() && info.size() != moves.size())) return false;
+    const int bytes = moveBytes(m_boardSize);
+
+    m_buff.clear();
+    m_buff += (char) (moves.size() & 0xFF);
+    m_buff += (char) (moves.size() >> 8);
+    m_buff += (char) (winner == black ? 1 : (winner == white ? 2 : 0));
+    m_buff += (char) (info.empty() ? 0 : FLAG_INFO);
+    for (auto m : moves) {
+        int code = m.x * m_boardSize + m.y;
+        m_buff += (char) (code & 0xFF);
+        if (bytes == 2) m_buff += (char) (code >> 8);
+    }
+    if (!info.empty()) m_buff.append(reinterpret_cast<const char *>(info.data()), info.size() * sizeof(MoveInfo));
+    // Flushed before the lock is released, so other writers never see part of the game
+    FileLock lock(m_file);
+    fseek(m_file, 0, SEEK_END);
+    bool ok = fwrite(m_buff.data(), 1, m_buff.size(), m_file) == m_buff.size();
+    return fflush(m_file) == 0 && ok;
+}
+
+/* Reader */
+
+Coord GameView::move(int i) const {
+    int code = moveBytes(m_boardSize) == 2 ? m_moves[2 * i] | m_moves[2 * i + 1] << 8 : m_moves[i];
+    return {static_cast<short>(code / m_boardSize), static_cast<short>(code % m_boardSize)};
+}
+
+MoveInfo GameView::info(int i) const {
+    MoveInfo res;
+    if (m_info != nullptr) memcpy(&res, m_info + i * sizeof(MoveInfo), sizeof(MoveInfo));
+    return res;
+}
+
+vector<Coord> GameView::moves() const {
+    vector<Coord> res(m_count);
+    for (int i = 0; i < m_count; ++i) res[i] = move(i);
+    return res;
+}
+
+GameRecordReader::~GameRecordReader() {
+    close();
+}
+
+bool GameRecordReader::open(const string &path) {
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st{};
+    void *mem = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t) st.st_size >= FILE_HEADER)
+        mem = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping stays valid without the descriptor
+    ::close(fd);
+    if (mem == MAP_FAILED) return false;
+
+    m_data = static_cast<const uint8_t *>(mem);
+    m_bytes = st.st_size;
+    m_boardSize = m_data[12];
+    m_rule = static_cast<GameRule>(m_data[13]);
+    if (fileHeader(m_boardSize, m_rule) != string(reinterpret_cast<const char *>(m_data), FILE_HEADER)) {
+        close();
+        return false;
+    }
+    madvise(mem, m_bytes, MADV_SEQUENTIAL);
+    return true;
+}
+
+void GameRecordReader::close() {
+    if (m_data == nullptr) return;
+    munmap(const_cast<uint8_t *>(m_data), m_bytes);
+    m_data = nullptr;
+    m_bytes = 0;
+}
+
+size_t GameRecordReader::begin() const {
+    return FILE_HEADER;
+}
+
+bool GameRecordReader::next(size_t &offset, GameView &game) const {
+    if (m_data == nullptr || offset + GAME_HEADER > m_bytes) return false;
+    const uint8_t *p = m_data + offset;
+    int count = p[0] | p[1] << 8;
+    bool hasInfo = p[3] & FLAG_INFO;
+    size_t size = GAME_HEADER + count * (moveBytes(m_boardSize) + (hasInfo ? sizeof(MoveInfo) : 0));
+    // A game cut off by a crash
+    if (offset + size > m_bytes) return false;
+
+    game.m_count = count;
+    game.m_boardSize = m_boardSize;
+    game.m_winner = p[2] == 1 ? black : (p[2] == 2 ? white : c_empty);
+    game.m_moves = p + GAME_HEADER;
+    game.m_info = hasInfo ? game.m_moves + count * moveBytes(m_boardSize) : nullptr;
+    offset += size;
+    return true;
+}
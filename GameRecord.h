@@ -0,0 +1,125 @@
+#ifndef GOMOKU_GAMERECORD_H
+#define GOMOKU_GAMERECORD_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "constants.h"
+
+/*
+ * Binary game records: a file header, then the games back to back, each one a 4-byte header, its moves and
+ * optionally an annotation per move. A move is r * size + c, in one byte when the board has at most 255 cells and
+ * two little-endian bytes otherwise. Files are only appended to, a game cut off by a crash is ignored by the reader
+ * and dropped by the next writer. Writers take an exclusive flock to drop it and to append, so several processes
+ * can write one file.
+ */
+
+// Rules of the games of a file
+enum GameRule : uint8_t {
+    // Five or more in a row wins
+    rule_freestyle = 0,
+    // Exactly five wins, an overline does not. The engine only plays freestyle, Tune refuses these records
+    rule_exact_five = 1,
+};
+
+// Search result behind a move
+struct MoveInfo {
+    // Of the side that moved
+    int32_t score = 0;
+    uint16_t timeMs = 0;
+    uint8_t depth = 0;
+    uint8_t reserved = 0;
+};
+
+static_assert(sizeof(MoveInfo) == 8, "MoveInfo is stored as is");
+
+class GameRecordWriter {
+public:
+    GameRecordWriter() = default;
+
+    GameRecordWriter(const GameRecordWriter &) = delete;
+
+    GameRecordWriter &operator=(const GameRecordWriter &) = delete;
+
+    ~GameRecordWriter();
+
+    // Append to path, creating it. Returns false if it cannot be written or holds games of another board or rule
+    bool open(const std::string &path, int boardSize, GameRule rule = rule_freestyle);
+
+    void close();
+
+    /*
+     * Append one game, black first, with winner c_empty for a draw or an unfinished game. info is empty or holds
+     * one entry per move. The game is written with a single fwrite and flushed under the lock.
+     */
+    bool write(const std::vector<Coord> &moves, Chess winner, const std::vector<MoveInfo> &info = {});
+
+private:
+    FILE *m_file = nullptr;
+    int m_boardSize = 0;
+    std::string m_buff;
+};
+
+// One game of a mapped file, pointing into the mapping
+class GameView {
+public:
+    [[nodiscard]] int size() const { return m_count; }
+
+    [[nodiscard]] Chess winner() const { return m_winner; }
+
+    [[nodiscard]] bool hasInfo() const { return m_info != nullptr; }
+
+    [[nodiscard]] Coord move(int i) const;
+
+    [[nodiscard]] MoveInfo info(int i) const;
+
+    [[nodiscard]] std::vector<Coord> moves() const;
+
+private:
+    friend class GameRecordReader;
+
+    const uint8_t *m_moves = nullptr, *m_info = nullptr;
+    int m_count = 0, m_boardSize = 0;
+    Chess m_winner = c_empty;
+};
+
+// Read-only mapping of a record file, iterated without copying
+class GameRecordReader {
+public:
+    GameRecordReader() = default;
+
+    GameRecordReader(const GameRecordReader &) = delete;
+
+    GameRecordReader &operator=(const GameRecordReader &) = delete;
+
+    ~GameRecordReader();
+
+    // Returns false if path is not a record file
+    bool open(const std::string &path);
+
+    void close();
+
+    [[nodiscard]] int getBoardSize() const { return m_boardSize; }
+
+    [[nodiscard]] GameRule getRule() const { return m_rule; }
+
+    // Read the game at offset into game and move offset past it, false at the end of the games
+    bool next(size_t &offset, GameView &game) const;
+
+    // Offset of the first game
+    [[nodiscard]] size_t begin() const;
+
+    // Bytes of the file
+    [[nodiscard]] size_t size() const { return m_bytes; }
+
+private:
+    const uint8_t *m_data = nullptr;
+    size_t m_bytes = 0;
+    int m_boardSize = 0;
+    GameRule m_rule = rule_freestyle;
+};
+
+
+#endif //GOMOKU_GAMERECORD_H
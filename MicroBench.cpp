@@ -0,0 +1,157 @@
+#include "Board.h"
+#include "RecordedGames.h"
+
+#include <cstring>
+#include <iostream>
+#include <functional>
+
+using namespace std;
+
+// Keeps the measured results alive
+volatile long long sink;
+
+// Run op over every sample position reps times, then print its cost per call as a JSON line
+void measure(const string &name, int reps, const function<long long()> &op) {
+    long long calls = 0, acc = 0;
+    auto start = Clock::now();
+    for (int i = 0; i < reps; ++i) {
+        calls += op();
+        acc += calls;
+    }
+    auto ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+    sink = acc;
+    cout << "{\"op\": \"" << name << "\", \"calls\": " << calls << ", \"ns_per_op\": "
+         << (double) ns / (calls > 0 ? calls : 1) << "}" << endl;
+}
+
+/*
+ * Usage: MicroBench [--reps N = 20]
+ * Measures the board primitives over every position of the recorded games, one JSON line per primitive.
+ */
+int main(int argc, char **argv) {
+    int reps = 20;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            cerr << "Missing value of " << argv[i] << endl;
+            return 1;
+        }
+        if (!strcmp(argv[i], "--reps")) reps = atoi(argv[i + 1]);
+        else {
+            cerr << "Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    // Sample positions: every unfinished position of the recorded games, with the side to move
+    Board board(1);
+    vector<BoardState<BOARD_SIZE>> states;
+    vector<Chess> sides;
+    for (const char *game : RECORDED_GAMES) {
+        board = Board(1);
+        auto moves = parseMoves(game);
+        for (int j = 0; j < (int) moves.size(); ++j) {
+            board.set(moves[j].x, moves[j].y, j % 2 ? white : black);
+            if (board.hasEnd()) break;
+            states.push_back(board.getState());
+            sides.push_back(j % 2 ? black : white);
+        }
+    }
+
+    // Empty cells next to the stones of each position, where the search places its moves
+    vector<vector<Coord>> cells(states.size());
+    for (int s = 0; s < (int) states.size(); ++s) {
+        board.setState(states[s]);
+        for (int r = 0; r < BOARD_SIZE; ++r)
+            for (int c = 0; c < BOARD_SIZE; ++c)
+                if (board.getGrid(r, c) == c_empty && board.hasNeighbor(r, c, 2, 1))
+                    cells[s].emplace_back(r, c);
+    }
+    cout << "{\"positions\": " << states.size() << ", \"reps\": " << reps << "}" << endl;
+
+    // The generator and cache samples each start with a setState(), this is its share of their ns_per_op
+    measure("setState", reps, [&]() {
+        for (auto &state : states) board.setState(state);
+        return (long long) states.size();
+    });
+
+    // A whole recorded game at once, as the Botzone front end does on its first turn
+    vector<vector<Coord>> games;
+    for (const char *game : RECORDED_GAMES) games.push_back(parseMoves(game));
+    measure("load (per game)", reps, [&]() {
+        for (auto &moves : games) board.load(moves);
+        return (long long) games.size();
+    });
+    const auto emptyState = Board(1).getState();
+    measure("set (per game)", reps, [&]() {
+        for (auto &moves : games) {
+            board.setState(emptyState);
+            for (int j = 0; j < (int) moves.size(); ++j) board.set(moves[j].x, moves[j].y, j % 2 ? white : black);
+        }
+        return (long long) games.size();
+    });
+
+    measure("set (make + unmake)", reps, [&]() {
+        long long n = 0;
+        for (int s = 0; s < (int) states.size(); ++s) {
+            board.setState(states[s]);
+            for (auto p : cells[s]) {
+                board.set(p.x, p.y, sides[s]);
+                board.set(p.x, p.y, c_empty);
+                n++;
+            }
+        }
+        return n;
+    });
+
+    const char *DIR_NAMES[4] = {"vertical", "horizontal", "diag_LU", "diag_RU"};
+    for (int dir = 0; dir < 4; ++dir)
+        measure(string("calculateScore ") + DIR_NAMES[dir], reps, [&]() {
+            long long n = 0, acc = 0;
+            for (int s = 0; s < (int) states.size(); ++s) {
+                board.setState(states[s]);
+                for (auto p : cells[s]) {
+                    acc += board.getPattern(p.x, p.y, black, static_cast<Direction>(dir));
+                    acc += board.getPattern(p.x, p.y, white, static_cast<Direction>(dir));
+                    n += 2;
+                }
+            }
+            sink = acc;
+            return n;
+        });
+
+    SearchContext context;
+    for (bool checkmateOnly : {false, true})
+        measure(checkmateOnly ? "heuristicGenerator checkmateOnly" : "heuristicGenerator", reps, [&]() {
+            long long n = 0, acc = 0;
+            for (int s = 0; s < (int) states.size(); ++s) {
+                board.setState(states[s]);
+                int size;
+                acc += board.heuristicGenerator(context.generator, sides[s], sides[s], size, checkmateOnly, true)->x;
+                acc += size;
+                n++;
+            }
+            sink = acc;
+            return n;
+        });
+
+    // The cache holds every sample position after one pass, the lookups with the other side to move miss
+    measure("cache", 1, [&]() {
+        for (int s = 0; s < (int) states.size(); ++s) {
+            board.setState(states[s]);
+            context.cache(board, sides[s], s, 1);
+        }
+        return (long long) states.size();
+    });
+    for (bool hit : {true, false})
+        measure(hit ? "getCache hit" : "getCache miss", reps, [&]() {
+            long long n = 0, acc = 0;
+            for (int s = 0; s < (int) states.size(); ++s) {
+                board.setState(states[s]);
+                CacheData data{};
+                acc += context.getCache(board, hit ? sides[s] : static_cast<Chess>(!sides[s]), data) ? data.score : -1;
+                n++;
+            }
+            sink = acc;
+            return n;
+        });
+}
@@ -2,32 +2,90 @@
 
 #include <iostream>
 #include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <sstream>
 
 using namespace std;
 
 
-Point MinimaxAI::calculate(string *buff) {
+string SearchStats::to_string() const {
+    ostringstream out;
+    out << "nodes: " << nodes << ", checkmate nodes: " << checkmateNodes << ", nps: " << nps()
+        << ", time: " << timeMs << "ms\n";
+    out << "cache probes: " << cacheProbes << ", hits: " << cacheHits << ", cutoffs: " << cacheCutoffs << "\n";
+    out << "cutoffs: " << cutoffs << ", on first move: " << firstMoveCutoffRate() * 100 << "%"
+        << ", generator calls: " << generatorCalls;
+    for (const auto &it : iterations)
+        out << "\n  d=" << it.depth << (it.completed ? "" : " (timeout)") << ": nodes " << it.nodes << ", "
+            << it.timeMs << "ms, ebf " << it.ebf;
+#ifdef GOMOKU_PROFILE
+    out << "\n" << profile.to_string();
+#endif
+    return out.str();
+}
+
+string SearchConfig::load(const string &path) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (file == nullptr) return "cannot open " + path;
+    char line[256];
+    string error;
+    for (int n = 1; error.empty() && fgets(line, sizeof(line), file); ++n) {
+        char name[32];
+        double value;
+        if (line[strspn(line, " \t\r\n")] == '#' || sscanf(line, "%31s", name) != 1) continue;
+        if (sscanf(line, "%31s %lf", name, &value) != 2)
+            error = "line " + ::to_string(n) + ": expected a name and a value";
+        else if (!strcmp(name, "weight")) weight = (float) value;
+        else if (!strcmp(name, "prune")) pruneLimit = (int) lround(value);
+        else if (!strcmp(name, "root_window")) rootWindow = (int) lround(value);
+        else if (!strcmp(name, "candidates") && value >= 1) candidateLimit = (int) lround(value);
+        else if (!strcmp(name, "checkmate_depth") && value >= 0) checkmateDepth = (int) lround(value);
+        else if (!strcmp(name, "depth_divisor") && value > 0) depthDivisor = value;
+        else error = "line " + ::to_string(n) + ": unknown or bad setting " + name;
+    }
+    fclose(file);
+    return error;
+}
+
+bool SearchConfig::save(const string &path) const {
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == nullptr) return false;
+    fprintf(file, "# Gomoku search settings\nweight %g\nprune %d\nroot_window %d\ncandidates %d\ncheckmate_depth %d\n"
+                  "depth_divisor %g\n", weight, pruneLimit, rootWindow, candidateLimit, checkmateDepth, depthDivisor);
+    return fclose(file) == 0;
+}
+
+template<int Size>
+Point BasicMinimaxAI<Size>::calculate(string *buff) {
     startT = Clock::now();
+#ifndef NDEBUG
+    const long hash = m_board->getHash();
+#endif
     m_breakout = false;
+    m_stats = SearchStats();
+    m_pv.clear();
+    // The context may be shared with a searcher of other settings
+    m_context->generator.candidateLimit = m_config.candidateLimit;
     int count = m_board->getCount();
 
     // First chess
     if (count == 0) {
-        srand(time(nullptr));
-        int t1 = rand() % 2, t2 = rand() % 2;
-        return Point(7 + t1, 7 + t2);
+        int t1 = (int) (m_rng() % 2), t2 = (int) (m_rng() % 2);
+        m_pv.emplace_back(BOARD_SIZE / 2 + t1, BOARD_SIZE / 2 + t2);
+        return Point(m_pv[0].x, m_pv[0].y);
     }
 
     // Generate points & duplicate
     int size = -1;
-    auto points = m_board->heuristicGenerator(m_identity, m_identity, size, false, true);
+    auto points = m_board->heuristicGenerator(m_context->generator, m_identity, m_identity, size, false, true);
+    m_stats.generatorCalls++;
     assert(size > 0);
     auto *candidates = new Point[size];
     for (int j = 0; j < size; ++j) {
         candidates[j] = Point(points[j]);
         // printf("(%d, %d)", candidates[j].x, candidates[j].y);
     }
-    std::cout << std::endl;
 
     // Do iter
     struct T {
@@ -35,15 +93,25 @@ Point MinimaxAI::calculate(string *buff) {
         int depth;
     };
     vector<T> result;
+    // Fall back on the best generated point if not even the first iteration finishes
+    T fallback;
+    fallback.p = Point(candidates[0]);
+    fallback.depth = 0;
 
     // int depth = count >= 12 ? 12 : (count >= 6 ? 10 : 8);
     // if (buff != nullptr) *buff = *buff + "d = " + to_string(depth) + "; ";
 
-    for (int i = 2; i <= MINIMAX_DEPTH; i += 2) {
+    for (int i = 2; i <= m_limits.depth; i += 2) {
         // printf("Depth (%d/%d)\n", i, depth);
+        auto iterT = Clock::now();
+        long long iterNodes = m_stats.nodes + m_stats.checkmateNodes;
         int resSize = miniMaxWrapper(i, candidates, size);
         assert(resSize > 0);
 
+        iterNodes = m_stats.nodes + m_stats.checkmateNodes - iterNodes;
+        m_stats.iterations.push_back({i, !m_breakout, iterNodes, MS_DIFF(iterT, Clock::now()),
+                                      pow((double) iterNodes, 1. / i)});
+
         if (!m_breakout) {
             for (int j = 0; j < resSize; ++j) {
                 auto p = candidates[j];
@@ -57,13 +125,14 @@ Point MinimaxAI::calculate(string *buff) {
         } else break;
     }
 
+    if (result.empty()) result.push_back(fallback);
     sort(result.begin(), result.end(), [this](const T &a, const T &b) {
         auto compEq = [this](int a, int b) {
-            if (abs(a - b) <= m_pruneLimit) return true;
+            if (abs(a - b) <= m_config.pruneLimit) return true;
             else return b < a;
         };
 
-        if (abs(a.p.ai_score - b.p.ai_score) > m_pruneLimit)
+        if (abs(a.p.ai_score - b.p.ai_score) > m_config.pruneLimit)
             return compEq(a.p.ai_score, b.p.ai_score);
         if (a.p.ai_score > 0) {
             // Is winning -> choose lower depth
@@ -76,173 +145,209 @@ Point MinimaxAI::calculate(string *buff) {
         }
     });
 
+    m_stats.timeMs = MS_DIFF(startT, Clock::now());
+    // Every candidate is searched in each iteration, so the line of the chosen move goes as deep as the last one
+    int searched = 0;
+    for (const auto &it : m_stats.iterations)
+        if (it.completed) searched = it.depth;
+    findPV(result.at(0).p, searched);
+#ifdef GOMOKU_PROFILE
+    m_stats.profile = profiler::collect();
+#endif
+    if (m_printStats)
+        std::cerr << m_stats.to_string() << std::endl;
+
     if (buff != nullptr) {
         *buff = *buff + "t: " + to_string(MS_DIFF(startT, Clock::now())) + "; ";
         *buff = *buff + "timeout: " + to_string(m_breakout) + ";";
         *buff = *buff + "final_d: " + to_string(result.at(0).depth) + "; ";
+        *buff = *buff + "nodes: " + to_string(m_stats.nodes + m_stats.checkmateNodes) + "; ";
+        *buff = *buff + "nps: " + to_string(m_stats.nps()) + "; ";
     } else {
         std::cout << "Time: " << MS_DIFF(startT, Clock::now()) << std::endl;
         std::cout << "Final Depth: " << result.at(0).depth << std::endl;
     }
 
     delete[] candidates;
+#ifndef NDEBUG
+    // Checked without assert, which constants.h may define to nothing while NDEBUG is not set
+    if (m_board->getHash() != hash) {
+        std::cerr << "calculate() did not restore the board" << std::endl;
+        abort();
+    }
+#endif
     return result.at(0).p;
 }
 
-int MinimaxAI::miniMaxWrapper(int depth, Point *candidates, int n) {
+template<int Size>
+int BasicMinimaxAI<Size>::miniMaxWrapper(int depth, Point *candidates, int n) {
     // Calculate
     // printf("%d", n);
 
     for (auto p = candidates; p != candidates + n; p++) {
         IN_RANGE(p->x, p->y);
         m_board->set(p->x, p->y, m_identity);
-        int score = miniMaxSearch(depth - 1, numeric_limits<int>::min(), numeric_limits<int>::max(),
-                                  static_cast<Chess>(!m_identity), false);
+        int score = negamaxSearch(depth - 1, -INF, INF, static_cast<Chess>(!m_identity), false, c_empty);
         m_board->set(p->x, p->y, c_empty);
-        p->ai_score = score;
 
         // Check if we still have time
-        auto t2 = Clock::now();
-        auto totalTime = MS_DIFF(startT, t2);
-        if (totalTime >= TIME_LIMIT - 15) {
-            // printf("Out of time! [left=%lld]\n", 1000 - totalTime);
+        if (m_breakout || limitReached()) {
+            // printf("Out of time! [left=%lld]\n", 1000 - MS_DIFF(startT, Clock::now()));
             m_breakout = true;
             break;
         }
+        p->ai_score = -score;
     }
 
     sort(candidates, candidates + n, [this](const auto a, const auto b) {
-        if (abs(b.ai_score - a.ai_score) < m_pruneLimit)
+        if (abs(b.ai_score - a.ai_score) < m_config.pruneLimit)
             return false;
         return b.ai_score < a.ai_score;
     });
 
     int maxVal = candidates[0].ai_score;
     int j;
-    for (j = 0; j < n; ++j) if (maxVal - candidates[j].ai_score > 10) break;
+    for (j = 0; j < n; ++j) if (maxVal - candidates[j].ai_score > m_config.rootWindow) break;
 
     return j;
 }
 
-int MinimaxAI::miniMaxSearch(int depth, int alpha, int beta, Chess player, bool checkmateOnly) {
+template<int Size>
+void BasicMinimaxAI<Size>::findPV(const Point &best, int depth) {
+    m_pv.assign(1, Coord(best.x, best.y));
+    m_board->set(best.x, best.y, m_identity);
+    auto player = static_cast<Chess>(!m_identity);
+    CacheData cache{};
+    // Follow the best moves of the cache, which may be missing or overwritten by other positions
+    while ((int) m_pv.size() < depth && !m_board->hasEnd() && m_context->getCache(*m_board, player, cache)) {
+        auto m = cache.move;
+        if (m.x < 0 || m.y < 0 || m.x >= BOARD_SIZE || m.y >= BOARD_SIZE || m_board->getGrid(m.x, m.y) != c_empty)
+            break;
+        m_board->set(m.x, m.y, player);
+        m_pv.push_back(m);
+        player = static_cast<Chess>(!player);
+    }
+    for (auto it = m_pv.rbegin(); it != m_pv.rend(); ++it) m_board->set(it->x, it->y, c_empty);
+}
+
+template<int Size>
+bool BasicMinimaxAI<Size>::limitReached() const {
+    if (m_stop != nullptr && m_stop->load(std::memory_order_relaxed))
+        return true;
+    if (m_limits.nodes > 0 && m_stats.nodes + m_stats.checkmateNodes >= m_limits.nodes)
+        return true;
+    return m_limits.timeMs > 0 && MS_DIFF(startT, Clock::now()) >= m_limits.timeMs - 15;
+}
+
+template<int Size>
+int BasicMinimaxAI<Size>::evaluate(Chess player) const {
+    // From the side to move whoever searches, so that both sides of a board share the cache
+    return static_cast<int>(m_board->getScore(player) -
+                            (1. - m_config.weight) * (float) m_board->getScore(static_cast<Chess>(!player)));
+}
+
+template<int Size>
+int BasicMinimaxAI<Size>::negamaxSearch(int depth, int alpha, int beta, Chess player, bool checkmateOnly,
+                                        Chess attacker) {
     assert(player != c_empty);
+    PROFILE_PLY();
+    PROFILE_SCOPE(checkmateOnly ? ps_checkmate : ps_search);
+    if (checkmateOnly) m_stats.checkmateNodes++;
+    else m_stats.nodes++;
 
     // Try use cache
     if (!checkmateOnly) {
-        auto cache = m_board->getCache();
-        if (cache != nullptr && cache->minimaxNode->depth >= depth)
-            return cache->minimaxNode->score;
+        CacheData cache{};
+        m_stats.cacheProbes++;
+        if (m_context->getCache(*m_board, player, cache)) {
+            m_stats.cacheHits++;
+            if (cache.depth >= depth) {
+                m_stats.cacheCutoffs++;
+                return cache.score;
+            }
+        }
     }
 
     // Reach the target depth
     if (depth == 0 && !m_board->hasEnd()) {
         if (!checkmateOnly) {
-            // Calculate checkmate for extra layers
-            int res = miniMaxSearch(CHECKMATE_DEPTH, alpha, beta, player, true);
-            m_board->cache(res, depth);
+            // Calculate checkmate for extra layers, attacked by the side to move
+            int res = negamaxSearch(m_config.checkmateDepth, alpha, beta, player, true, player);
+            if (!m_breakout && res != NO_SCORE)
+                m_context->cache(*m_board, player, res, depth);
             return res;
         } else {
             // Checkmate calculation finished, return
-            return static_cast<int>(m_board->getScore(m_identity) -
-                                    (1. - m_weight) * (float) m_board->getScore(static_cast<Chess>(!m_identity)));
+            return evaluate(player);
         }
     }
 
     // Game has ended, return
     if (m_board->hasEnd()) {
-        int res = static_cast<int>(m_board->getScore(m_identity) -
-                                   (1. - m_weight) * (float) m_board->getScore(static_cast<Chess>(!m_identity)));
+        // Scaled up by the plies left, so that both sides prefer the quicker win and the slower loss
+        int res = checkmateOnly ? evaluate(player)
+                                : static_cast<int>(evaluate(player) * (1. + depth / m_config.depthDivisor));
         if (!checkmateOnly)
-            m_board->cache(res, depth);
+            m_context->cache(*m_board, player, res, depth);
         return res;
     }
 
     // Generate point candidates
     int size = -1;
-    auto points = m_board->heuristicGenerator(player, m_identity, size, checkmateOnly, true);
+    auto points = m_board->heuristicGenerator(m_context->generator, player, checkmateOnly ? attacker : player, size,
+                                              checkmateOnly, true);
+    m_stats.generatorCalls++;
     // printf("%d ", size);
 
     // If in checkmate mode and no res, end
-    if (size <= 0 && checkmateOnly) {
-        return static_cast<int>(m_board->getScore(m_identity) -
-                                (1. - m_weight) * (float) m_board->getScore(static_cast<Chess>(!m_identity)));
-    }
+    if (size <= 0 && checkmateOnly)
+        return evaluate(player);
     assert(size > 0);
 
     // Duplicate points to local var
     auto *points_duplicated = new Point[size];
     for (int j = 0; j < size; ++j) points_duplicated[j] = Point(points[j]);
 
-    if (player == m_identity) {
-        // Maximize
-        int maxScore = numeric_limits<int>::min();
-        for (int j = 0; j < size; ++j) {
-            auto p = points_duplicated[j];
-
-            IN_RANGE(p.x, p.y);
-            m_board->set(p.x, p.y, player);
-            int r = miniMaxSearch(depth - 1, alpha, beta, static_cast<Chess>(!player), checkmateOnly);
-            m_board->set(p.x, p.y, c_empty);
-
-            if (MS_DIFF(startT, Clock::now()) >= TIME_LIMIT - 15) {
-                m_breakout = true;
-                // printf("BREAK: t=%lld, d=%d, %s\n", MS_DIFF(startT, Clock::now()), depth, "MAX");
-                break;
-            }
-
-            if (r == numeric_limits<int>::max())
-                // In case if we reach time limit
-                continue;
+    int bestScore = NO_SCORE;
+    Coord bestMove;
+    for (int j = 0; j < size; ++j) {
+        auto p = points_duplicated[j];
 
-            int score = r;
-            maxScore = max(maxScore, score);
+        IN_RANGE(p.x, p.y);
+        m_board->set(p.x, p.y, player);
+        int r = negamaxSearch(depth - 1, -beta, -alpha, static_cast<Chess>(!player), checkmateOnly, attacker);
+        m_board->set(p.x, p.y, c_empty);
 
-            // Pruning
-            alpha = max(alpha, maxScore);
-            if (alpha >= beta + m_pruneLimit)
-                break;
-            if (alpha >= _5)
-                break;
+        if (m_breakout || limitReached()) {
+            m_breakout = true;
+            // printf("BREAK: t=%lld, d=%d\n", MS_DIFF(startT, Clock::now()), depth);
+            break;
         }
-        if (!checkmateOnly)
-            m_board->cache(maxScore, depth);
-        delete[] points_duplicated;
-        return maxScore;
-    } else {
-        // Minimize
-        int minScore = numeric_limits<int>::max();
-        for (int j = 0; j < size; ++j) {
-            auto p = points_duplicated[j];
-
-            IN_RANGE(p.x, p.y);
-            m_board->set(p.x, p.y, player);
-            int r = miniMaxSearch(depth - 1, alpha, beta, static_cast<Chess>(!player), checkmateOnly);
-            m_board->set(p.x, p.y, c_empty);
-
-            if (MS_DIFF(startT, Clock::now()) >= TIME_LIMIT - 15) {
-                m_breakout = true;
-                // printf("BREAK: t=%lld, d=%d, %s\n", MS_DIFF(startT, Clock::now()), depth, "MIN");
-                break;
-            }
 
-            if (r == numeric_limits<int>::min())
-                // In case if we reach time limit
-                continue;
+        if (r == NO_SCORE)
+            // In case if we reach time limit
+            continue;
 
-            int score = static_cast<int>(r * (1. + depth / 10.));
-            minScore = min(minScore, score);
+        int score = -r;
+        if (score > bestScore) {
+            bestScore = score;
+            bestMove = Coord(p.x, p.y);
+        }
 
-            // Pruning
-            beta = min(beta, minScore);
-            if (alpha >= beta + m_pruneLimit)
-                break;
-            if (beta <= -_5)
-                break;
+        // Pruning, alpha has to exceed beta by the prune limit
+        alpha = max(alpha, bestScore);
+        if (static_cast<long long>(alpha) >= static_cast<long long>(beta) + m_config.pruneLimit || alpha >= _5) {
+            m_stats.cutoffs++;
+            if (j == 0) m_stats.firstMoveCutoffs++;
+            break;
         }
-        if (!checkmateOnly)
-            m_board->cache(minScore, depth);
-        delete[] points_duplicated;
-        return minScore;
     }
+    if (!checkmateOnly && !m_breakout && bestScore != NO_SCORE)
+        m_context->cache(*m_board, player, bestScore, depth, bestMove);
+    delete[] points_duplicated;
+    return bestScore;
 }
 
+template class BasicMinimaxAI<15>;
+template class BasicMinimaxAI<19>;
+template class BasicMinimaxAI<20>;
@@ -1,31 +1,171 @@
 #ifndef GOMOKU_MINIMAXAI_H
 #define GOMOKU_MINIMAXAI_H
 
+#include <atomic>
+#include <memory>
+#include <random>
 #include <string>
+#include <limits>
+#include <vector>
 
 #include "constants.h"
 #include "Board.h"
+#include "Profiler.h"
 
-class MinimaxAI {
+// Counters of one calculate() call
+struct SearchStats {
+    struct Iteration {
+        int depth;
+        bool completed;
+        long long nodes, timeMs;
+        // Effective branching factor, nodes^(1 / depth)
+        double ebf;
+    };
+
+    long long nodes = 0, checkmateNodes = 0;
+    // Cache probes, probes that found an entry, and entries deep enough to return from
+    long long cacheProbes = 0, cacheHits = 0, cacheCutoffs = 0;
+    // Beta cutoffs, and those caused by the first move searched
+    long long cutoffs = 0, firstMoveCutoffs = 0;
+    long long generatorCalls = 0;
+    long long timeMs = 0;
+    std::vector<Iteration> iterations;
+#ifdef GOMOKU_PROFILE
+    // Hot-path counters of the calling thread
+    ProfileData profile;
+#endif
+
+    // Nodes per second, counting checkmate nodes
+    [[nodiscard]] long long nps() const { return (nodes + checkmateNodes) * 1000 / (timeMs > 0 ? timeMs : 1); }
+
+    [[nodiscard]] double firstMoveCutoffRate() const { return cutoffs ? (double) firstMoveCutoffs / cutoffs : 0; }
+
+    [[nodiscard]] std::string to_string() const;
+};
+
+// Limits of one calculate() call
+struct SearchLimits {
+    // Deepest iteration, iterative deepening goes 2 plies at a time
+    int depth = MINIMAX_DEPTH;
+    // Wall-clock budget in ms, 0 for none
+    int timeMs = TIME_LIMIT;
+    // Budget of searched nodes, checkmate nodes included, 0 for none. Without a time limit the search is
+    // deterministic, the same position and seed give the same move
+    long long nodes = 0;
+};
+
+// Tunable settings of the search, see Spsa.cpp
+struct SearchConfig {
+    // The evaluation is the score of the side to move minus (1 - weight) times the opponent's
+    float weight = 0.5;
+    // Scores closer than this are equal, and a cutoff needs alpha to exceed beta by it
+    int pruneLimit = 20;
+    // Root moves within this of the best one are kept as choices after each iteration
+    int rootWindow = 10;
+    // Most moves searched in a position without threes or fours
+    int candidateLimit = 20;
+    // Plies of the threat search at the leaves
+    int checkmateDepth = CHECKMATE_DEPTH;
+    // An ended game found depth plies above the leaves scores 1 + depth / depthDivisor times its evaluation, preferring
+    // quicker wins and slower losses
+    double depthDivisor = 10;
+
+    // Read "name value" lines, missing names keep their value. Returns an empty string or the error of a bad line
+    std::string load(const std::string &path);
+
+    bool save(const std::string &path) const;
+};
+
+/*
+ * Searches the board it is given, which calculate() changes during the search and restores before returning. The rest
+ * of the state a search changes is in the instance and in its search context (generator scratch and cache), its own
+ * unless setContext shares one. A board and a context serve one search at a time; searches on different boards with
+ * different contexts may run on different threads at the same time, and contexts may share a TranspositionTable.
+ */
+template<int Size>
+class BasicMinimaxAI {
 public:
-    MinimaxAI(Board *board, Chess identity, float weight = 0.5, int pruneLimit = 20) :
-            m_board(board), m_identity(identity), m_weight(weight), m_pruneLimit(pruneLimit), m_breakout(false) {}
+    static constexpr int BOARD_SIZE = Size;
+
+    BasicMinimaxAI(BasicBoard<Size> *board, Chess identity, float weight = 0.5, int pruneLimit = 20) :
+            m_breakout(false), m_board(board), m_identity(identity),
+            m_context(std::make_shared<BasicSearchContext<Size>>()), m_rng(board->getSeed() * 2 + identity) {
+        m_config.weight = weight;
+        m_config.pruneLimit = pruneLimit;
+    }
 
     Point calculate(std::string *buff = nullptr);
 
+    /* Limits */
+    [[nodiscard]] const SearchLimits &getLimits() const { return m_limits; }
+
+    void setLimits(const SearchLimits &limits) { m_limits = limits; }
+
+    /* Settings */
+    [[nodiscard]] const SearchConfig &getConfig() const { return m_config; }
+
+    // Replaces the weight and prune limit given to the constructor too
+    void setConfig(const SearchConfig &config) { m_config = config; }
+
+    /* Context */
+    [[nodiscard]] const std::shared_ptr<BasicSearchContext<Size>> &getContext() const { return m_context; }
+
+    // Search with context, e.g. the one of the searcher of the other side of the board so that both share the cache
+    void setContext(std::shared_ptr<BasicSearchContext<Size>> context) { m_context = std::move(context); }
+
+    // Seed of the random choices, by default derived from the seed of the board
+    void setSeed(unsigned long seed) { m_rng.seed(seed); }
+
+    // Stop the search as soon as *stop is set, e.g. from another thread. nullptr for none
+    void setStopFlag(const std::atomic<bool> *stop) { m_stop = stop; }
+
+    /* Statistics */
+    // Of the last calculate() call
+    [[nodiscard]] const SearchStats &getStats() const { return m_stats; }
+
+    // Print the statistics to stderr after each calculate() call
+    void setPrintStats(bool enabled) { m_printStats = enabled; }
+
+    // Principal variation of the last calculate() call, starting with the chosen move, as far as the cache holds it
+    [[nodiscard]] const std::vector<Coord> &getPV() const { return m_pv; }
+
 private:
-    float m_weight;
+    SearchConfig m_config;
     bool m_breakout;
-    int m_pruneLimit;
-    Board *m_board;
+    BasicBoard<Size> *m_board;
     Chess m_identity;
+    std::shared_ptr<BasicSearchContext<Size>> m_context;
     std::chrono::time_point<Clock> startT;
+    SearchLimits m_limits;
+    const std::atomic<bool> *m_stop = nullptr;
+    SearchStats m_stats;
+    bool m_printStats = false;
+    std::vector<Coord> m_pv;
+    std::mt19937_64 m_rng;
+
+    // Bounds of the search window, and the score of a node that ran out of time before finishing a child
+    static constexpr int INF = std::numeric_limits<int>::max();
+    static constexpr int NO_SCORE = std::numeric_limits<int>::min();
 
     int miniMaxWrapper(int depth, Point *candidates, int n);
 
-    int miniMaxSearch(int depth, int alpha, int beta, Chess player, bool checkmateOnly);
+    /*
+     * Negamax: the returned score is relative to player, the side to move, and so are the cached scores.
+     * In checkmate mode the threats are generated for attacker, the side to move where the checkmate search began.
+     */
+    int negamaxSearch(int depth, int alpha, int beta, Chess player, bool checkmateOnly, Chess attacker);
+
+    // Fill m_pv from the chosen move, searched depth plies deep
+    void findPV(const Point &best, int depth);
+
+    // Whether the time or node budget is spent, or the search was stopped
+    [[nodiscard]] bool limitReached() const;
+
+    // Static score of the board for player, the side to move
+    [[nodiscard]] int evaluate(Chess player) const;
 };
 
+using MinimaxAI = BasicMinimaxAI<BOARD_SIZE>;
 
 
 #endif //GOMOKU_MINIMAXAI_H
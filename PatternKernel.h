@@ -0,0 +1,119 @@
+#ifndef GOMOKU_PATTERNKERNEL_H
+#define GOMOKU_PATTERNKERNEL_H
+
+#include <cstdint>
+#include "constants.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+
+// Threat classes looked at by Board::heuristicGenerator
+enum ThreatClass {
+    t_5 = 0, t_4p, t_4m, t_3p, t_2p, THREAT_CLASSES
+};
+
+const Pattern THREAT_PATTERN[THREAT_CLASSES] = {p_5, p_4p, p_4m, p_3p, p_2p};
+
+/*
+ * Pattern weights, also split into byte planes so that the vector kernels can look them up with a byte shuffle.
+ * Weights must be non-negative and below 2^24.
+ */
+struct PatternLUT {
+    int weights[PATTERN_COUNT]{};
+    alignas(16) unsigned char lo[16]{}, mid[16]{}, hi[16]{};
+
+    explicit PatternLUT(const int *w) {
+        for (int i = 0; i < PATTERN_COUNT; ++i) {
+            weights[i] = w[i];
+            assert(w[i] >= 0 && w[i] < (1 << 24));
+            lo[i] = w[i] & 0xFF;
+            mid[i] = (w[i] >> 8) & 0xFF;
+            hi[i] = (w[i] >> 16) & 0xFF;
+        }
+    }
+};
+
+const PatternLUT PATTERN_LUT(PATTERN_SCORE);
+
+// Totals and threat classes of one player over a stored row of Stride cells
+template<int Stride>
+struct RowSummary {
+    int total[Stride];
+#ifdef __AVX2__
+    // One nibble per cell, bit d of the nibble is set if direction d holds the class
+    uint64_t mask[THREAT_CLASSES][(Stride + 15) / 16];
+
+    [[nodiscard]] unsigned getMask(ThreatClass cls, int c) const {
+        return (mask[cls][c >> 4] >> ((c & 15) << 2)) & 0xF;
+    }
+#else
+    // One word per cell, nibble k holds the directions of threat class k
+    uint32_t classes[Stride];
+
+    [[nodiscard]] unsigned getMask(ThreatClass cls, int c) const {
+        return (classes[c] >> (cls << 2)) & 0xF;
+    }
+#endif
+
+    [[nodiscard]] int getCount(ThreatClass cls, int c) const {
+        // Bit count of the nibble, looked up in a packed table so builds without popcnt stay fast
+        return static_cast<int>((0x4332322132212110ull >> (getMask(cls, c) << 2)) & 0xF);
+    }
+};
+
+/*
+ * Fill in the summary of a row. Only the cells flagged in candidates are guaranteed to be filled: the AVX2 kernel
+ * does 8 cells at once, while the scalar fallback looks at the candidates alone. Narrower vectors did not pay off
+ * over the scalar code, since a row rarely holds more than a few candidates.
+ */
+template<int Stride>
+inline void summarizeRow(const Pattern (*codes)[4], const PatternLUT &lut, unsigned candidates,
+                         RowSummary<Stride> &out) {
+#ifdef __AVX2__
+    const __m256i tLo = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) lut.lo)),
+            tMid = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) lut.mid)),
+            tHi = _mm256_broadcastsi128_si256(_mm_load_si128((const __m128i *) lut.hi)),
+            // Bit k set for the threat class k of each pattern, 0 if the pattern is not looked at
+            tClass = _mm256_broadcastsi128_si256(_mm_setr_epi8(0, 0, 0, 0, 0, 1 << t_2p, 0, 1 << t_3p, 1 << t_4m,
+                                                               1 << t_4p, 1 << t_5, 0, 0, 0, 0, 0));
+    const __m256i ones8 = _mm256_set1_epi8(1), ones16 = _mm256_set1_epi16(1);
+    auto sum4 = [&](__m256i x) { return _mm256_madd_epi16(_mm256_maddubs_epi16(x, ones8), ones16); };
+
+    for (int w = 0; w < Stride; w += 16) {
+        uint64_t mask[THREAT_CLASSES]{};
+        // 8 cells per step
+        for (int c = w; c < w + 16 && c < Stride; c += 8) {
+            if (!((candidates >> c) & 0xFF)) continue;
+            __m256i v = _mm256_loadu_si256((const __m256i *) (codes + c));
+            __m256i total = _mm256_add_epi32(
+                    sum4(_mm256_shuffle_epi8(tLo, v)),
+                    _mm256_add_epi32(_mm256_slli_epi32(sum4(_mm256_shuffle_epi8(tMid, v)), 8),
+                                     _mm256_slli_epi32(sum4(_mm256_shuffle_epi8(tHi, v)), 16)));
+            _mm256_storeu_si256((__m256i *) (out.total + c), total);
+            // One-hot class byte per direction, then each class bit is moved to the sign bit for movemask
+            __m256i onehot = _mm256_shuffle_epi8(tClass, v);
+            for (int k = 0; k < THREAT_CLASSES; ++k) {
+                auto bits = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_slli_epi16(onehot, 7 - k)));
+                mask[k] |= static_cast<uint64_t>(bits) << ((c - w) << 2);
+            }
+        }
+        for (int k = 0; k < THREAT_CLASSES; ++k) out.mask[k][w >> 4] = mask[k];
+    }
+#else
+    // Threat class of each pattern as a one-hot nibble index, 0 if the pattern is not looked at
+    static const uint32_t CLASS_BIT[16] = {0, 0, 0, 0, 0, 1u << (t_2p << 2), 0, 1u << (t_3p << 2),
+                                           1u << (t_4m << 2), 1u << (t_4p << 2), 1u << (t_5 << 2)};
+
+    for (; candidates; candidates &= candidates - 1) {
+        int c = __builtin_ctz(candidates);
+        const auto &s = codes[c];
+        out.total[c] = lut.weights[s[0]] + lut.weights[s[1]] + lut.weights[s[2]] + lut.weights[s[3]];
+        out.classes[c] = CLASS_BIT[s[0]] | CLASS_BIT[s[1]] << 1 | CLASS_BIT[s[2]] << 2 | CLASS_BIT[s[3]] << 3;
+    }
+#endif
+}
+
+
+#endif //GOMOKU_PATTERNKERNEL_H
@@ -0,0 +1,74 @@
+#ifndef GOMOKU_PATTERNWEIGHTS_H
+#define GOMOKU_PATTERNWEIGHTS_H
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include "constants.h"
+
+/*
+ * Evaluation weights loaded at runtime, from a text file of "name value" lines: a pattern of PATTERN_NAMES and its
+ * weight, or "weight" and the opponent weight of MinimaxAI. Missing entries keep the compiled defaults, '#' starts a
+ * comment. Written by Tune.
+ */
+
+// Names of the patterns in weight files, by pattern id
+const char *const PATTERN_NAMES[PATTERN_COUNT] = {"empty", "1m", "1p", "2m", "2p_spaced", "2p", "3m", "3p", "4m",
+                                                  "4p", "5"};
+
+// Largest weight of the patterns below a five, so that only fives reach the win score _5
+const int MAX_PATTERN_WEIGHT = _5 / 20;
+
+struct EvalWeights {
+    int patterns[PATTERN_COUNT]{};
+    // Opponent weight of MinimaxAI
+    float weight = 0;
+
+    EvalWeights() {
+        for (int i = 0; i < PATTERN_COUNT; ++i) patterns[i] = PATTERN_SCORE[i];
+    }
+
+    // Returns an empty string, or the error of the first bad line
+    std::string load(const std::string &path) {
+        FILE *file = fopen(path.c_str(), "r");
+        if (file == nullptr) return "cannot open " + path;
+        char line[256];
+        std::string error;
+        for (int n = 1; error.empty() && fgets(line, sizeof(line), file); ++n) {
+            char name[32];
+            double value;
+            if (line[strspn(line, " \t\r\n")] == '#' || sscanf(line, "%31s", name) != 1) continue;
+            if (sscanf(line, "%31s %lf", name, &value) != 2) {
+                error = "line " + std::to_string(n) + ": expected a name and a value";
+                continue;
+            }
+            if (!strcmp(name, "weight")) {
+                weight = (float) value;
+                continue;
+            }
+            int id = 0;
+            while (id < PATTERN_COUNT && strcmp(name, PATTERN_NAMES[id]) != 0) id++;
+            if (id == PATTERN_COUNT) error = "line " + std::to_string(n) + ": unknown pattern " + name;
+            else if ((id == p_empty || id == p_5) && (int) value != PATTERN_SCORE[id])
+                error = "line " + std::to_string(n) + ": " + name + " must stay " + std::to_string(PATTERN_SCORE[id]);
+            else if (id != p_empty && id != p_5 && (value < 0 || value > MAX_PATTERN_WEIGHT))
+                error = "line " + std::to_string(n) + ": " + name + " out of [0, " +
+                        std::to_string(MAX_PATTERN_WEIGHT) + "]";
+            else patterns[id] = (int) value;
+        }
+        fclose(file);
+        return error;
+    }
+
+    bool save(const std::string &path) const {
+        FILE *file = fopen(path.c_str(), "w");
+        if (file == nullptr) return false;
+        fprintf(file, "# Gomoku evaluation weights\n");
+        for (int i = p_empty + 1; i < p_5; ++i) fprintf(file, "%s %d\n", PATTERN_NAMES[i], patterns[i]);
+        fprintf(file, "weight %g\n", weight);
+        return fclose(file) == 0;
+    }
+};
+
+
+#endif //GOMOKU_PATTERNWEIGHTS_H
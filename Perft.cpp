@@ -0,0 +1,116 @@
+#include "Board.h"
+#include "RecordedGames.h"
+
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+using namespace std;
+
+// Plies of each recorded game used as perft roots
+const int PERFT_PLIES[] = {9, 14, 19};
+
+struct PerftCounters {
+    long long nodes = 0, leaves = 0, generatorCalls = 0;
+};
+
+struct Perft {
+    Board &board;
+    GeneratorContext<BOARD_SIZE> ctx;
+    bool checkmateOnly, verify;
+    PerftCounters counters;
+    string error;
+
+    Perft(Board &board, bool checkmateOnly, bool verify) : board(board), checkmateOnly(checkmateOnly), verify(verify) {}
+
+    // Enumerate the generator outputs depth plies deep, player to move
+    void run(int depth, Chess player) {
+        counters.nodes++;
+        if (verify && error.empty()) {
+            error = board.checkState();
+            if (!error.empty()) error += " after\n" + board.to_string();
+        }
+        if (depth == 0 || board.hasEnd()) {
+            counters.leaves++;
+            return;
+        }
+
+        int size = 0;
+        auto points = board.heuristicGenerator(ctx, player, player, size, checkmateOnly, true);
+        counters.generatorCalls++;
+        if (size <= 0) {
+            counters.leaves++;
+            return;
+        }
+        // The context is reused by the children
+        vector<Point> moves(points, points + size);
+        for (auto p : moves) {
+            board.set(p.x, p.y, player);
+            run(depth - 1, static_cast<Chess>(!player));
+            board.set(p.x, p.y, c_empty);
+        }
+    }
+};
+
+/*
+ * Usage: Perft [--depth N = 3] [--checkmate] [--seed S = 1]
+ * From fixed positions of the recorded games, enumerates the heuristicGenerator moves N plies deep. The first pass
+ * checks the incrementally maintained board state against a from-scratch recomputation at every node, the second
+ * one is timed without the checks. Prints one JSON line per position and a summary line, exits 1 on a mismatch.
+ */
+int main(int argc, char **argv) {
+    int depth = 3;
+    bool checkmateOnly = false;
+    unsigned long seed = 1;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--depth") && i + 1 < argc) depth = atoi(argv[++i]);
+        else if (!strcmp(argv[i], "--seed") && i + 1 < argc) seed = strtoul(argv[++i], nullptr, 10);
+        else if (!strcmp(argv[i], "--checkmate")) checkmateOnly = true;
+        else {
+            cerr << "Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    PerftCounters total;
+    long long totalNs = 0;
+    for (int g = 0; g < RECORDED_GAME_COUNT; ++g) {
+        auto moves = parseMoves(RECORDED_GAMES[g]);
+        for (int ply : PERFT_PLIES) {
+            if (ply >= (int) moves.size()) continue;
+            Board board(seed);
+            board.setCanonicalHashing(true);
+            board.load(vector<Coord>(moves.begin(), moves.begin() + ply));
+            if (board.hasEnd()) continue;
+            auto side = ply % 2 ? white : black;
+
+            // On the heap for the size of the generator context
+            auto checked = unique_ptr<Perft>(new Perft(board, checkmateOnly, true));
+            checked->run(depth, side);
+            if (!checked->error.empty()) {
+                cerr << "Position " << g << "@" << ply << ": " << checked->error << endl;
+                return 1;
+            }
+            auto timed = unique_ptr<Perft>(new Perft(board, checkmateOnly, false));
+            auto start = Clock::now();
+            timed->run(depth, side);
+            auto ns = chrono::duration_cast<chrono::nanoseconds>(Clock::now() - start).count();
+            const auto &c = timed->counters;
+            cout << "{\"position\": \"" << g << "@" << ply << "\", \"nodes\": " << c.nodes << ", \"leaves\": "
+                 << c.leaves << ", \"generator_calls\": " << c.generatorCalls << ", \"time_ms\": " << ns / 1000000
+                 << ", \"nodes_per_s\": " << (long long) (c.nodes * 1e9 / (ns > 0 ? ns : 1)) << "}" << endl;
+
+            total.nodes += c.nodes;
+            total.leaves += c.leaves;
+            total.generatorCalls += c.generatorCalls;
+            totalNs += ns;
+        }
+    }
+
+    cout << "{\"depth\": " << depth << ", \"checkmate_only\": " << (checkmateOnly ? "true" : "false")
+         << ", \"nodes\": " << total.nodes << ", \"leaves\": " << total.leaves
+         << ", \"generator_calls\": " << total.generatorCalls << ", \"time_ms\": " << totalNs / 1000000
+         << ", \"nodes_per_s\": " << (long long) (total.nodes * 1e9 / (totalNs > 0 ? totalNs : 1))
+         << ", \"generator_calls_per_s\": " << (long long) (total.generatorCalls * 1e9 / (totalNs > 0 ? totalNs : 1))
+         << "}" << endl;
+}
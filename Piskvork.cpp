@@ -0,0 +1,355 @@
+#include "Board.h"
+#include "MinimaxAI.h"
+#include "PatternKernel.h"
+#include "PatternWeights.h"
+#include "TranspositionTable.h"
+
+#include <atomic>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <thread>
+
+using namespace std;
+
+// Cache entries without a max_memory limit, 64 MB
+const size_t DEFAULT_TT_ENTRIES = 1 << 22;
+// Share of max_memory given to the cache
+const double TT_MEMORY_SHARE = 0.5;
+const char *const ABOUT = R"(name="Gomoku-cpp", version="1.0", author="ykozxy", country="CN")";
+// Evaluation weights written by Tune and search settings written by Spsa, read next to the executable when present
+const char *const WEIGHTS_FILE = "weights.txt";
+const char *const SEARCH_FILE = "search.txt";
+
+// Read one line without its line break, false at the end of the input
+bool readLine(string &line) {
+    char buff[256];
+    line.clear();
+    while (fgets(buff, sizeof(buff), stdin)) {
+        line += buff;
+        if (line.back() == '\n') break;
+    }
+    if (line.empty() && feof(stdin)) return false;
+    while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+    return true;
+}
+
+void reply(const string &line) {
+    fputs((line + "\n").c_str(), stdout);
+    fflush(stdout);
+}
+
+// Command name of line, upper case
+string commandOf(const string &line) {
+    string res;
+    for (char c : line) {
+        if (c == ' ') break;
+        res += (char) toupper(c);
+    }
+    return res;
+}
+
+// Time limits of the INFO command, in ms
+struct TimeControl {
+    // Per move, 0 to play as fast as possible
+    int turn = 30000;
+    // Per game, 0 for none
+    int match = 0;
+    int left = INT_MAX;
+
+    // Budget of the next move, leaving a margin for the reply to reach the manager
+    [[nodiscard]] int budget(int emptyCells) const {
+        const int margin = 50, minimum = 30;
+        int t = turn > 0 ? turn : minimum;
+        // Spread the time left over the moves still expected, about one of ours per 10 empty cells
+        if (match > 0 && left != INT_MAX) t = min(t, left / max(10, emptyCells / 10));
+        return max(minimum, t - margin);
+    }
+};
+
+// Settings of the INFO command and of the files next to the executable, kept across games
+struct PiskvorkSettings {
+    TimeControl time;
+    // Bytes, 0 for no limit
+    long long maxMemory = 0;
+    PatternLUT weights{PATTERN_SCORE};
+    SearchConfig search;
+
+    PiskvorkSettings() {
+        search.weight = 0;
+        search.pruneLimit = 10;
+    }
+
+    // Load the files of dir that exist, a file that does not load leaves the built-in settings. Returns the errors
+    string load(const string &dir) {
+        string errors;
+        EvalWeights loadedWeights;
+        SearchConfig loadedSearch = search;
+        if (exists(dir + WEIGHTS_FILE)) {
+            auto error = loadedWeights.load(dir + WEIGHTS_FILE);
+            if (error.empty()) {
+                weights = PatternLUT(loadedWeights.patterns);
+                loadedSearch.weight = search.weight = loadedWeights.weight;
+            } else errors += (errors.empty() ? "" : "; ") + string(WEIGHTS_FILE) + ": " + error;
+        }
+        if (exists(dir + SEARCH_FILE)) {
+            auto error = loadedSearch.load(dir + SEARCH_FILE);
+            if (error.empty()) search = loadedSearch;
+            else errors += (errors.empty() ? "" : "; ") + string(SEARCH_FILE) + ": " + error;
+        }
+        return errors;
+    }
+
+    static bool exists(const string &path) {
+        FILE *file = fopen(path.c_str(), "r");
+        if (file != nullptr) fclose(file);
+        return file != nullptr;
+    }
+
+    // Returns whether max_memory changed
+    bool info(const char *args) {
+        char key[32];
+        long long value;
+        if (sscanf(args, "%31s %lld", key, &value) != 2) return false;
+        if (!strcmp(key, "timeout_turn")) time.turn = (int) value;
+        else if (!strcmp(key, "timeout_match")) time.match = (int) value;
+        else if (!strcmp(key, "time_left")) time.left = (int) min<long long>(value, INT_MAX);
+        else if (!strcmp(key, "max_memory") && value != maxMemory) {
+            maxMemory = value;
+            return true;
+        }
+        return false;
+    }
+};
+
+/*
+ * One engine of the Piskvork protocol for a board size. Coordinates of the protocol are "column,row".
+ * After each reply, the engine searches its answer to the reply its principal variation expects until the next
+ * command arrives, so that the search after that reply finds its results in the cache.
+ */
+template<int Size>
+class PiskvorkEngine {
+public:
+    explicit PiskvorkEngine(PiskvorkSettings &settings) : m_board(time(nullptr)), m_settings(settings) {
+        m_board.setCanonicalHashing(true);
+        m_board.setWeights(&m_settings.weights);
+        resizeTable();
+    }
+
+    ~PiskvorkEngine() { stopPondering(); }
+
+    /*
+     * Answer the commands of a game until END or a START of another board size.
+     * Returns that size, or 0 at END or at the end of the input.
+     */
+    int run() {
+        reply("OK");
+        string line;
+        while (readLine(line)) {
+            auto command = commandOf(line);
+            const char *args = line.c_str() + min(line.size(), command.size() + 1);
+            // Only commands using the board or the engine stop the ponder, INFO and ABOUT also come between moves
+            if (command == "TURN" || command == "BEGIN" || command == "BOARD" || command == "START" ||
+                command == "RESTART" || command == "TAKEBACK" || command == "END")
+                stopPondering();
+
+            if (command == "START") {
+                int size = atoi(args);
+                if (size != Size) return size;
+                restart();
+                reply("OK");
+            } else if (command == "RESTART") {
+                restart();
+                reply("OK");
+            } else if (command == "BEGIN") {
+                setIdentity(black);
+                play();
+            } else if (command == "TURN") {
+                int x, y;
+                if (!parseMove(args, x, y) || m_board.getGrid(y, x) != c_empty) {
+                    reply("ERROR bad move " + string(args));
+                    continue;
+                }
+                if (m_ai == nullptr) setIdentity(m_board.getCount() % 2 ? black : white);
+                m_board.set(y, x, static_cast<Chess>(!m_identity));
+                play();
+            } else if (command == "BOARD") {
+                readBoard();
+            } else if (command == "TAKEBACK") {
+                int x, y;
+                if (!parseMove(args, x, y) || m_board.getGrid(y, x) == c_empty) {
+                    reply("ERROR bad move " + string(args));
+                    continue;
+                }
+                m_board.set(y, x, c_empty);
+                reply("OK");
+            } else if (command == "INFO") {
+                if (m_settings.info(args)) {
+                    stopPondering();
+                    resizeTable();
+                }
+            } else if (command == "ABOUT") {
+                reply(ABOUT);
+            } else if (command == "END") {
+                return 0;
+            } else {
+                reply("UNKNOWN " + command);
+            }
+        }
+        return 0;
+    }
+
+private:
+    BasicBoard<Size> m_board;
+    TranspositionTable m_table;
+    // Kept across the engines of the games, so that the cache outlives them
+    shared_ptr<BasicSearchContext<Size>> m_context = make_shared<BasicSearchContext<Size>>();
+    PiskvorkSettings &m_settings;
+    Chess m_identity = black;
+    unique_ptr<BasicMinimaxAI<Size>> m_ai;
+
+    thread m_ponder;
+    atomic<bool> m_stopPonder{false};
+
+    static bool parseMove(const char *args, int &x, int &y) {
+        return sscanf(args, "%d,%d", &x, &y) == 2 && x >= 0 && y >= 0 && x < Size && y < Size;
+    }
+
+    void restart() {
+        m_board.load({});
+        m_ai.reset();
+    }
+
+    void setIdentity(Chess identity) {
+        m_identity = identity;
+        m_ai = make_unique<BasicMinimaxAI<Size>>(&m_board, identity);
+        m_ai->setConfig(m_settings.search);
+        m_ai->setContext(m_context);
+        m_ai->setStopFlag(&m_stopPonder);
+    }
+
+    // Cache within max_memory, emptied on a change
+    void resizeTable() {
+        size_t entries = DEFAULT_TT_ENTRIES;
+        if (m_settings.maxMemory > 0) entries = (size_t) (m_settings.maxMemory * TT_MEMORY_SHARE) / 16;
+        m_context->setTable(nullptr);
+        if (m_table.openPrivate(m_board.getSeed(), Size, true, max<size_t>(entries, 1024)))
+            m_context->setTable(&m_table);
+    }
+
+    // "x,y,field" lines up to DONE, field 1 for own stones and 2 for the opponent's
+    void readBoard() {
+        restart();
+        vector<pair<Coord, int>> stones;
+        string line;
+        int own = 0, opponent = 0;
+        while (readLine(line) && commandOf(line) != "DONE") {
+            int x, y, field;
+            if (sscanf(line.c_str(), "%d,%d,%d", &x, &y, &field) != 3 || !parseMove(line.c_str(), x, y) ||
+                (field != 1 && field != 2))
+                continue;
+            stones.emplace_back(Coord(y, x), field);
+            (field == 1 ? own : opponent)++;
+        }
+        // Black has moved as often as white when it is to move, white once less than black
+        setIdentity(own < opponent ? white : black);
+        for (const auto &s : stones)
+            m_board.set(s.first.x, s.first.y, s.second == 1 ? m_identity : static_cast<Chess>(!m_identity));
+        play();
+    }
+
+    // Search, reply with the move and start pondering
+    void play() {
+        if (m_ai == nullptr) setIdentity(m_board.getCount() % 2 ? white : black);
+        SearchLimits limits;
+        limits.timeMs = m_settings.time.budget(Size * Size - m_board.getCount());
+        m_ai->setLimits(limits);
+        string buff;
+        auto p = m_ai->calculate(&buff);
+        m_board.set(p.x, p.y, m_identity);
+        if (!buff.empty()) {
+            buff += " pv:";
+            for (auto m : m_ai->getPV()) buff += " " + to_string(m.y) + "," + to_string(m.x);
+            reply("MESSAGE " + buff);
+        }
+        reply(to_string(p.y) + "," + to_string(p.x));
+        startPondering();
+    }
+
+    void startPondering() {
+        const auto &pv = m_ai->getPV();
+        if (pv.size() < 2 || m_board.hasEnd() || m_board.getGrid(pv[1].x, pv[1].y) != c_empty) return;
+        Coord expected = pv[1];
+        SearchLimits limits;
+        limits.timeMs = 0;
+        m_ai->setLimits(limits);
+        m_stopPonder = false;
+        m_ponder = thread([this, expected]() {
+            auto opponent = static_cast<Chess>(!m_identity);
+            m_board.set(expected.x, expected.y, opponent);
+            if (!m_board.hasEnd() && m_board.getCount() < Size * Size) {
+                string buff;
+                m_ai->calculate(&buff);
+            }
+            m_board.set(expected.x, expected.y, c_empty);
+        });
+    }
+
+    // Must be called before touching the board
+    void stopPondering() {
+        if (!m_ponder.joinable()) return;
+        m_stopPonder = true;
+        m_ponder.join();
+        m_stopPonder = false;
+    }
+};
+
+// Answer the commands before a game, returns the board size of START or 0 at END or at the end of the input
+int waitForStart(PiskvorkSettings &settings) {
+    string line;
+    while (readLine(line)) {
+        auto command = commandOf(line);
+        const char *args = line.c_str() + min(line.size(), command.size() + 1);
+        if (command == "START") {
+            int size = atoi(args);
+            if (size == 15 || size == 19 || size == 20) return size;
+            reply("ERROR unsupported size " + to_string(size));
+        } else if (command == "INFO") settings.info(args);
+        else if (command == "ABOUT") reply(ABOUT);
+        else if (command == "END") return 0;
+        else if (!command.empty()) reply("ERROR expected START");
+    }
+    return 0;
+}
+
+/*
+ * Usage: Piskvork
+ * Plays through the Piskvork / Gomocup protocol on stdin and stdout: START, RESTART, BEGIN, TURN, BOARD, TAKEBACK,
+ * INFO timeout_turn / timeout_match / time_left / max_memory, ABOUT and END. Boards of 15, 19 and 20 are supported.
+ * Evaluates with the weights of weights.txt (see PatternWeights.h) and searches with the settings of search.txt (see
+ * SearchConfig) when they are next to the executable, and with the built-in ones otherwise.
+ */
+int main(int argc, char **argv) {
+    PiskvorkSettings settings;
+    string path = argc > 0 ? argv[0] : "";
+    auto errors = settings.load(path.substr(0, path.find_last_of("/\\") + 1));
+    if (!errors.empty()) reply("MESSAGE ignored " + errors);
+    int size = waitForStart(settings);
+    while (size != 0) {
+        switch (size) {
+            case 15:
+                size = PiskvorkEngine<15>(settings).run();
+                break;
+            case 19:
+                size = PiskvorkEngine<19>(settings).run();
+                break;
+            case 20:
+                size = PiskvorkEngine<20>(settings).run();
+                break;
+            default:
+                reply("ERROR unsupported size " + to_string(size));
+                size = waitForStart(settings);
+        }
+    }
+}
@@ -0,0 +1,121 @@
+#ifndef GOMOKU_PROFILER_H
+#define GOMOKU_PROFILER_H
+
+#include "constants.h"
+
+/*
+ * Hot-path counters and scoped timers, enabled by defining GOMOKU_PROFILE (cmake -DGOMOKU_PROFILE=ON).
+ * When it is off, PROFILE_SCOPE and PROFILE_PLY expand to nothing.
+ * Calls and self time (nested sections excluded, so the sections add up to the time spent) are kept per thread
+ * and per ply from the root, checkmate plies follow the main search ones. The search depth and the checkmate depth
+ * are runtime settings, so the plies are not sized from them: plies from PROFILE_PLIES - 1 on share the last slot,
+ * printed as "N+".
+ * BasicMinimaxAI::calculate collects the counters of its thread at the end of each call.
+ */
+enum ProfileSection {
+    ps_set = 0, ps_updateGrid, ps_calculateScore, ps_generator, ps_getCache, ps_cache, ps_search, ps_checkmate,
+    PROFILE_SECTIONS
+};
+
+const int PROFILE_PLIES = 32;
+
+#ifdef GOMOKU_PROFILE
+
+#include <mutex>
+#include <sstream>
+#include <string>
+
+struct ProfileData {
+    long long calls[PROFILE_SECTIONS][PROFILE_PLIES]{};
+    long long ns[PROFILE_SECTIONS][PROFILE_PLIES]{};
+
+    void add(const ProfileData &other) {
+        for (int s = 0; s < PROFILE_SECTIONS; ++s)
+            for (int p = 0; p < PROFILE_PLIES; ++p) {
+                calls[s][p] += other.calls[s][p];
+                ns[s][p] += other.ns[s][p];
+            }
+    }
+
+    [[nodiscard]] std::string to_string() const {
+        static const char *NAMES[PROFILE_SECTIONS] = {"set", "updateGrid", "calculateScore", "generator",
+                                                      "getCache", "cache", "search", "checkmate"};
+        std::ostringstream out;
+        out << "section: calls, ms | ply: calls, ms";
+        for (int s = 0; s < PROFILE_SECTIONS; ++s) {
+            long long totalCalls = 0, totalNs = 0;
+            for (int p = 0; p < PROFILE_PLIES; ++p) totalCalls += calls[s][p], totalNs += ns[s][p];
+            out << "\n  " << NAMES[s] << ": " << totalCalls << ", " << totalNs / 1000000.0 << " |";
+            // Plies never reached are left out
+            for (int p = 0; p < PROFILE_PLIES; ++p)
+                if (calls[s][p])
+                    out << " " << p << (p == PROFILE_PLIES - 1 ? "+" : "") << ": " << calls[s][p] << ", "
+                        << ns[s][p] / 1000000.0;
+        }
+        return out.str();
+    }
+};
+
+namespace profiler {
+    inline thread_local ProfileData local;
+    inline thread_local int ply = 0;
+
+    class Scope;
+
+    // Innermost open scope of this thread
+    inline thread_local Scope *current = nullptr;
+
+    // Counters of all threads collected so far
+    inline ProfileData total;
+    inline std::mutex totalMutex;
+
+    // Add the counters of this thread to the total, then reset and return them
+    inline ProfileData collect() {
+        ProfileData res = local;
+        local = ProfileData();
+        std::lock_guard<std::mutex> lock(totalMutex);
+        total.add(res);
+        return res;
+    }
+
+    class Scope {
+    public:
+        explicit Scope(ProfileSection section) :
+                m_section(section), m_ply(ply < PROFILE_PLIES ? ply : PROFILE_PLIES - 1), m_parent(current),
+                m_start(Clock::now()) { current = this; }
+
+        ~Scope() {
+            long long elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - m_start).count();
+            local.calls[m_section][m_ply]++;
+            local.ns[m_section][m_ply] += elapsed - m_childNs;
+            if (m_parent) m_parent->m_childNs += elapsed;
+            current = m_parent;
+        }
+
+    private:
+        ProfileSection m_section;
+        int m_ply;
+        Scope *m_parent;
+        long long m_childNs = 0;
+        std::chrono::time_point<Clock> m_start;
+    };
+
+    struct PlyScope {
+        PlyScope() { ply++; }
+
+        ~PlyScope() { ply--; }
+    };
+}
+
+#define PROFILE_SCOPE(section) profiler::Scope _profileScope(section)
+#define PROFILE_PLY() profiler::PlyScope _profilePly
+
+#else
+
+#define PROFILE_SCOPE(section)
+#define PROFILE_PLY()
+
+#endif
+
+
+#endif //GOMOKU_PROFILER_H
@@ -0,0 +1,42 @@
+#ifndef GOMOKU_RECORDEDGAMES_H
+#define GOMOKU_RECORDEDGAMES_H
+
+#include <cstdio>
+#include <vector>
+#include "constants.h"
+
+/*
+ * Self-play games on the 15x15 board, used as sample positions by the benchmarks.
+ * Moves are "row,column" pairs separated by spaces, black moves first.
+ */
+const char *const RECORDED_GAMES[] = {
+        "7,7 7,8 8,9 8,7 6,9 9,9 6,6 6,7 5,5 4,4 4,6 7,6 6,4 7,3 3,7 2,8 6,5 6,3 3,5 4,5 5,4 5,7 3,8 3,6 "
+        "5,6 4,7 5,3 5,1 5,2",
+        "7,7 8,8 6,9 8,7 8,9 7,9 6,10 6,11 7,10 5,10 8,11 5,8 10,13 9,12 6,8 4,10 8,6 9,5 6,7 6,5 6,6",
+        "7,7 6,8 8,6 7,9 5,7 8,7 7,5 6,4 6,6 8,4 7,6 7,4 9,4 5,6 9,6 10,6 9,5 9,3 8,5 6,5 6,7 10,3 5,8",
+        "7,7 8,7 9,9 8,8 8,10 10,8 9,8 8,6 8,5 9,7 7,5 10,6 7,9 11,5 12,4 10,7 10,5 11,6 9,6 11,7 12,7 "
+        "11,4 11,2 11,3",
+        "7,7 6,6 8,9 7,5 5,7 4,7 7,9 7,10 6,8 4,6 5,9 4,10 6,9 4,9 4,8 9,9 6,10 6,11 7,11 3,7 8,12",
+        "7,7 7,8 5,8 8,9 6,7 5,7 8,5 7,6 9,5 10,4 6,5 7,5 8,4 8,6 10,6 11,7 6,6 6,4 9,7 8,8 5,3 6,8 8,10 "
+        "7,3 4,6 8,2 9,1 9,8 10,8 10,7 7,10 11,5 9,3 11,6 12,5 11,4 11,2 11,3",
+        "7,7 8,8 9,6 9,7 10,6 8,6 8,7 10,8 11,9 11,8 9,8 7,5 6,4 10,9 10,5 11,4 10,3 10,4 10,10 12,8 7,8 "
+        "6,9 13,8 8,4 9,4 9,3 6,6 11,2 11,1 7,10 8,11 8,2 11,5 9,2 10,2 7,1 6,0 8,3 8,1 8,5",
+        "7,7 6,8 5,6 7,8 8,8 6,6 6,9 6,7 6,5 8,3 4,7 3,8 5,8 3,6 8,11 7,10 8,9 8,10 5,9 7,9 5,7 5,4 5,5",
+};
+
+const int RECORDED_GAME_COUNT = sizeof(RECORDED_GAMES) / sizeof(RECORDED_GAMES[0]);
+
+// "row,column" moves separated by spaces, up to the first text that is not one. end receives where it stopped
+inline std::vector<Coord> parseMoves(const char *moves, const char **end = nullptr) {
+    std::vector<Coord> res;
+    int r, c, n;
+    while (sscanf(moves, "%d,%d%n", &r, &c, &n) == 2) {
+        res.emplace_back(r, c);
+        moves += n;
+    }
+    if (end != nullptr) *end = moves;
+    return res;
+}
+
+
+#endif //GOMOKU_RECORDEDGAMES_H
@@ -0,0 +1,52 @@
+#include "GameRecord.h"
+
+#include <cstring>
+#include <iostream>
+
+using namespace std;
+
+/*
+ * Usage: Records FILE [--dump]
+ * Prints a JSON summary of a game record file, see GameRecord.h. With --dump, prints the games instead, one per line
+ * as "row,column" moves, the input of Analyse.
+ */
+int main(int argc, char **argv) {
+    if (argc < 2) {
+        cerr << "Usage: Records FILE [--dump]" << endl;
+        return 1;
+    }
+    bool dump = argc > 2 && !strcmp(argv[2], "--dump");
+
+    auto startT = Clock::now();
+    GameRecordReader reader;
+    if (!reader.open(argv[1])) {
+        cerr << "Not a game record file: " << argv[1] << endl;
+        return 1;
+    }
+
+    long long games = 0, moves = 0, annotated = 0, wins[3] = {};
+    size_t offset = reader.begin();
+    GameView game;
+    string line;
+    while (reader.next(offset, game)) {
+        games++;
+        moves += game.size();
+        annotated += game.hasInfo();
+        wins[game.winner() == c_empty ? 2 : game.winner()]++;
+        if (!dump) continue;
+        line.clear();
+        for (int i = 0; i < game.size(); ++i) {
+            auto m = game.move(i);
+            line += (i ? " " : "") + to_string(m.x) + "," + to_string(m.y);
+        }
+        cout << line << "\n";
+    }
+    if (dump) return 0;
+
+    cout << "{\"board_size\": " << reader.getBoardSize() << ", \"rule\": " << (int) reader.getRule()
+         << ", \"games\": " << games << ", \"moves\": " << moves << ", \"annotated_games\": " << annotated
+         << ", \"black_wins\": " << wins[black] << ", \"white_wins\": " << wins[white] << ", \"draws\": " << wins[2]
+         << ", \"average_length\": " << (games ? (double) moves / games : 0)
+         << ", \"trailing_bytes\": " << reader.size() - offset
+         << ", \"time_ms\": " << MS_DIFF(startT, Clock::now()) << "}" << endl;
+}
@@ -0,0 +1,407 @@
+#include "Board.h"
+#include "MinimaxAI.h"
+#include "PatternKernel.h"
+#include "PatternWeights.h"
+#include "RecordedGames.h"
+#include "TranspositionTable.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <sstream>
+#include <thread>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace std;
+
+// Time kept back from each deadline for the reply to reach the client
+const int DEADLINE_MARGIN = 10;
+
+// One client of the server, replies of the workers and of the reader are written whole lines at a time
+class Connection {
+public:
+    explicit Connection(int fd) : m_fd(fd) {}
+
+    ~Connection() { close(m_fd); }
+
+    void send(const string &line) {
+        string buff = line + "\n";
+        lock_guard<mutex> lock(m_mutex);
+        for (size_t sent = 0; sent < buff.size();) {
+            auto n = ::send(m_fd, buff.data() + sent, buff.size() - sent, MSG_NOSIGNAL);
+            if (n <= 0) return;
+            sent += n;
+        }
+    }
+
+    // Next line without its line break, false once the client is gone
+    bool readLine(string &line) {
+        size_t end;
+        while ((end = m_input.find('\n')) == string::npos) {
+            char buff[4096];
+            auto n = read(m_fd, buff, sizeof(buff));
+            if (n <= 0) return false;
+            m_input.append(buff, n);
+        }
+        line = m_input.substr(0, end);
+        m_input.erase(0, end + 1);
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        return true;
+    }
+
+private:
+    int m_fd;
+    mutex m_mutex;
+    string m_input;
+};
+
+// Settings of the whole server
+struct ServerConfig {
+    string socketPath = "/tmp/gomoku.sock";
+    int threads = (int) max(1u, thread::hardware_concurrency());
+    SearchLimits limits;
+    SearchConfig search;
+    // Pattern weights of every board, PATTERN_LUT if null
+    const PatternLUT *lut = nullptr;
+    // Zobrist seed of every board, and base of the seeds of the games' random choices
+    unsigned long seed = 1;
+    // Entries of the table shared by all games, 64 MB by default. A cache per game would grow without bound
+    size_t tableEntries = 1 << 22;
+    // POSIX shared memory name of the table, to share it with other processes too
+    string sharedTable;
+
+    ServerConfig() {
+        search.weight = 0;
+        search.pruneLimit = 10;
+    }
+};
+
+// A hosted game: its board and an engine for each side, searching the board of the game
+template<int Size>
+struct ServerGame {
+    BasicBoard<Size> board;
+    vector<BasicMinimaxAI<Size>> engines;
+    // Set while a search is queued or running, the board is the search's until then
+    bool busy = false;
+
+    // The zobrist seed is the server's, which the table needs, the random choices draw from the seed of the game
+    ServerGame(const ServerConfig &config, unsigned long gameSeed, TranspositionTable *table) : board(config.seed) {
+        board.setCanonicalHashing(true);
+        if (config.lut != nullptr) board.setWeights(config.lut);
+        engines.reserve(2);
+        for (int p = 0; p < 2; ++p) {
+            engines.emplace_back(&board, static_cast<Chess>(p));
+            engines.back().setConfig(config.search);
+            engines.back().setLimits(config.limits);
+            engines.back().setSeed(gameSeed * 2 + p);
+        }
+        // Both sides share one context, and through it the table
+        engines[0].getContext()->setTable(table);
+        engines[1].setContext(engines[0].getContext());
+    }
+
+    [[nodiscard]] Chess turn() const { return board.getCount() % 2 ? white : black; }
+};
+
+template<int Size>
+struct SearchJob {
+    Clock::time_point deadline;
+    shared_ptr<ServerGame<Size>> game;
+    shared_ptr<Connection> client;
+    string id;
+
+    // Latest deadline first out of a priority_queue, so that it serves the earliest one
+    bool operator<(const SearchJob &o) const { return deadline > o.deadline; }
+};
+
+/*
+ * Worker pool shared by all games, searching the queued moves earliest deadline first.
+ * Each search gets the time left until its deadline, so a queue longer than the pool shortens the searches instead
+ * of making them late.
+ */
+template<int Size>
+class SearchScheduler {
+public:
+    explicit SearchScheduler(int threads) {
+        for (int t = 0; t < threads; ++t) m_workers.emplace_back([this]() { work(); });
+    }
+
+    ~SearchScheduler() {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_ready.notify_all();
+        for (auto &t : m_workers) t.join();
+    }
+
+    void push(SearchJob<Size> job) {
+        {
+            lock_guard<mutex> lock(m_mutex);
+            m_jobs.push(move(job));
+        }
+        m_ready.notify_one();
+    }
+
+    // Guards the busy flag of the games
+    mutex &gameMutex() { return m_gameMutex; }
+
+private:
+    priority_queue<SearchJob<Size>> m_jobs;
+    mutex m_mutex, m_gameMutex;
+    condition_variable m_ready;
+    bool m_stop = false;
+    vector<thread> m_workers;
+
+    void work() {
+        while (true) {
+            SearchJob<Size> job;
+            {
+                unique_lock<mutex> lock(m_mutex);
+                m_ready.wait(lock, [this]() { return m_stop || !m_jobs.empty(); });
+                if (m_stop) return;
+                job = m_jobs.top();
+                m_jobs.pop();
+            }
+            search(job);
+        }
+    }
+
+    void search(const SearchJob<Size> &job) {
+        auto &game = *job.game;
+        auto &engine = game.engines[game.turn()];
+        auto limits = engine.getLimits();
+        // MinimaxAI stops 15 ms before its limit
+        limits.timeMs = (int) max<long long>(MS_DIFF(Clock::now(), job.deadline) - DEADLINE_MARGIN + 15, 20);
+        engine.setLimits(limits);
+
+        string buff;
+        auto side = game.turn();
+        auto p = engine.calculate(&buff);
+        game.board.set(p.x, p.y, side);
+        const auto &stats = engine.getStats();
+        int depth = 0;
+        for (const auto &it : stats.iterations)
+            if (it.completed) depth = it.depth;
+        long long late = MS_DIFF(job.deadline, Clock::now());
+
+        ostringstream out;
+        out << "BEST " << job.id << " " << p.x << "," << p.y << " score " << p.ai_score << " depth " << depth
+            << " nodes " << stats.nodes + stats.checkmateNodes << " time " << stats.timeMs;
+        if (late > 0) out << " late " << late;
+        if (game.board.hasEnd()) out << " win";
+        {
+            lock_guard<mutex> lock(m_gameMutex);
+            game.busy = false;
+        }
+        job.client->send(out.str());
+    }
+};
+
+template<int Size>
+class GameServer {
+public:
+    explicit GameServer(const ServerConfig &config) : m_config(config), m_scheduler(config.threads) {}
+
+    // Returns an empty string or the reason the table cannot be opened
+    string openTable() {
+        bool ok = m_config.sharedTable.empty()
+                  ? m_table.openPrivate(m_config.seed, Size, true, m_config.tableEntries)
+                  : m_table.openShared(m_config.sharedTable, m_config.seed, Size, true, m_config.tableEntries);
+        return ok ? "" : m_table.getError();
+    }
+
+    // Answer the commands of one client until it disconnects, its games end with it
+    void serve(const shared_ptr<Connection> &client) {
+        map<string, shared_ptr<ServerGame<Size>>> games;
+        string line;
+        while (client->readLine(line)) {
+            istringstream in(line);
+            string command, id;
+            in >> command >> id;
+            if (command.empty()) continue;
+            if (command == "QUIT") break;
+            if (id.empty()) {
+                client->send("ERROR missing game id");
+                continue;
+            }
+
+            if (command == "NEW") {
+                games[id] = make_shared<ServerGame<Size>>(m_config, m_config.seed ^ m_nextGame++, &m_table);
+                client->send("OK " + id);
+                continue;
+            }
+            auto it = games.find(id);
+            if (it == games.end()) {
+                client->send("ERROR " + id + " unknown game");
+                continue;
+            }
+            auto game = it->second;
+            {
+                lock_guard<mutex> lock(m_scheduler.gameMutex());
+                if (game->busy) {
+                    client->send("ERROR " + id + " searching");
+                    continue;
+                }
+            }
+
+            string rest;
+            getline(in, rest);
+            if (command == "END") {
+                games.erase(it);
+                client->send("OK " + id);
+            } else if (command == "LOAD" || command == "MOVE") {
+                auto moves = parseMoves(rest.c_str());
+                if (command == "LOAD") game->board.load({});
+                string error = play(*game, moves);
+                client->send(error.empty() ? "OK " + id : "ERROR " + id + " " + error);
+            } else if (command == "GO") {
+                int ms = atoi(rest.c_str());
+                if (ms <= 0 || game->board.hasEnd() || game->board.getCount() == Size * Size) {
+                    client->send("ERROR " + id + (ms <= 0 ? " bad deadline" : " game over"));
+                    continue;
+                }
+                {
+                    lock_guard<mutex> lock(m_scheduler.gameMutex());
+                    game->busy = true;
+                }
+                m_scheduler.push({Clock::now() + chrono::milliseconds(ms), game, client, id});
+            } else {
+                client->send("ERROR unknown command " + command);
+            }
+        }
+    }
+
+private:
+    ServerConfig m_config;
+    TranspositionTable m_table;
+    SearchScheduler<Size> m_scheduler;
+    // Number of the next game of any client, so that games do not repeat each other's random choices
+    atomic<unsigned long> m_nextGame{1};
+
+    // Play moves for the sides to move, stopping at the first illegal one
+    static string play(ServerGame<Size> &game, const vector<Coord> &moves) {
+        for (auto m : moves) {
+            if (game.board.hasEnd()) return "game over";
+            if (m.x < 0 || m.y < 0 || m.x >= Size || m.y >= Size || game.board.getGrid(m.x, m.y) != c_empty)
+                return "illegal move " + to_string(m.x) + "," + to_string(m.y);
+            game.board.set(m.x, m.y, game.turn());
+        }
+        return "";
+    }
+};
+
+template<int Size>
+int run(const ServerConfig &config) {
+    // Shared with the client threads, which are detached and may outlive this function
+    auto server = make_shared<GameServer<Size>>(config);
+    auto error = server->openTable();
+    if (!error.empty()) {
+        cerr << "Cannot open the table: " << error << endl;
+        return 1;
+    }
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    if (fd < 0 || config.socketPath.size() >= sizeof(addr.sun_path)) {
+        cerr << "Cannot create the socket " << config.socketPath << endl;
+        return 1;
+    }
+    strcpy(addr.sun_path, config.socketPath.c_str());
+    unlink(config.socketPath.c_str());
+    if (bind(fd, (sockaddr *) &addr, sizeof(addr)) != 0 || listen(fd, 64) != 0) {
+        cerr << "Cannot listen on " << config.socketPath << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    cerr << "Listening on " << config.socketPath << " with " << config.threads << " search threads" << endl;
+
+    while (true) {
+        int clientFd = accept(fd, nullptr, nullptr);
+        if (clientFd < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        auto client = make_shared<Connection>(clientFd);
+        thread([server, client]() { server->serve(client); }).detach();
+    }
+    close(fd);
+    return 0;
+}
+
+/*
+ * Usage: Server [options]
+ * Hosts many games over a Unix domain socket, searching them on one pool of threads. Commands, one per line:
+ *   NEW id                 start a game
+ *   LOAD id r,c r,c ...    set the moves of the game, black first;  MOVE id r,c ...  play moves after them
+ *   GO id MS               search the side to move, to answer within MS ms, and play the move. Replies later with
+ *                          "BEST id r,c score S depth D nodes N time T [late L] [win]"
+ *   END id                 drop a game;  QUIT  close the connection, which drops its games
+ * Other replies are "OK id" and "ERROR [id] message".
+ * Options:
+ *   --socket PATH = /tmp/gomoku.sock    --size 15 | 19 | 20    --threads N = all cores    --depth N = 8
+ *   --table ENTRIES = 4194304           entries of the cache of all games, 16 bytes each
+ *   --shared-table NAME                 that table in POSIX shared memory, shared with other processes
+ *   --seed S = 1                        zobrist seed of all boards, the same for every process using the table;
+ *                                       game n draws its random choices from S ^ n
+ *   --weights FILE                      evaluate with the weights of a file, see PatternWeights.h
+ *   --search FILE                       search with the settings of a file written by Spsa; the later of --weights
+ *                                       and --search sets the opponent weight
+ */
+int main(int argc, char **argv) {
+    ServerConfig config;
+    EvalWeights weights;
+    unique_ptr<PatternLUT> lut;
+    int size = BOARD_SIZE;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            cerr << "Missing value of " << argv[i] << endl;
+            return 1;
+        }
+        if (!strcmp(argv[i], "--socket")) config.socketPath = argv[i + 1];
+        else if (!strcmp(argv[i], "--size")) size = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--threads")) config.threads = max(1, atoi(argv[i + 1]));
+        else if (!strcmp(argv[i], "--depth")) config.limits.depth = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--table")) config.tableEntries = max(1024ul, strtoul(argv[i + 1], nullptr, 10));
+        else if (!strcmp(argv[i], "--shared-table")) config.sharedTable = argv[i + 1];
+        else if (!strcmp(argv[i], "--seed")) config.seed = strtoul(argv[i + 1], nullptr, 10);
+        else if (!strcmp(argv[i], "--weights")) {
+            auto error = weights.load(argv[i + 1]);
+            if (!error.empty()) {
+                cerr << "Bad weights: " << error << endl;
+                return 1;
+            }
+            lut = make_unique<PatternLUT>(weights.patterns);
+            config.lut = lut.get();
+            config.search.weight = weights.weight;
+        } else if (!strcmp(argv[i], "--search")) {
+            auto error = config.search.load(argv[i + 1]);
+            if (!error.empty()) {
+                cerr << "Bad search settings: " << error << endl;
+                return 1;
+            }
+        } else {
+            cerr << "Unknown option " << argv[i] << endl;
+            return 1;
+        }
+    }
+
+    switch (size) {
+        case 15:
+            return run<15>(config);
+        case 19:
+            return run<19>(config);
+        case 20:
+            return run<20>(config);
+        default:
+            cerr << "Unsupported board size: " << size << endl;
+            return 1;
+    }
+}
@@ -0,0 +1,293 @@
+#include "Board.h"
+#include "MinimaxAI.h"
+#include "PatternKernel.h"
+#include "PatternWeights.h"
+#include "RecordedGames.h"
+
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// Exponents of the gain and perturbation schedules, the usual choice of SPSA
+const double ALPHA = 0.602, GAMMA = 0.101;
+
+// A tuned field of SearchConfig
+struct SpsaParam {
+    const char *name;
+    double lo, hi;
+    // Perturbation of the first iteration
+    double c;
+    bool integer;
+    double SearchConfig::*real;
+    int SearchConfig::*whole;
+    float SearchConfig::*single;
+
+    [[nodiscard]] double get(const SearchConfig &config) const {
+        return real != nullptr ? config.*real : (whole != nullptr ? config.*whole : config.*single);
+    }
+
+    void set(SearchConfig &config, double value) const {
+        value = min(max(value, lo), hi);
+        if (real != nullptr) config.*real = value;
+        else if (whole != nullptr) config.*whole = (int) lround(value);
+        else config.*single = (float) value;
+    }
+};
+
+// Every field is spelled out: name, lo, hi, c, integer, then exactly one of the real, whole and single members
+const SpsaParam SPSA_PARAMS[] = {
+        {"weight",          0, 1,   0.05, false, nullptr, nullptr, &SearchConfig::weight},
+        {"prune",           0, 200, 4,    true,  nullptr, &SearchConfig::pruneLimit, nullptr},
+        {"root_window",     0, 200, 4,    true,  nullptr, &SearchConfig::rootWindow, nullptr},
+        {"candidates",      4, 40,  2,    true,  nullptr, &SearchConfig::candidateLimit, nullptr},
+        {"checkmate_depth", 0, 8,   1,    true,  nullptr, &SearchConfig::checkmateDepth, nullptr},
+        {"depth_divisor",   2, 50,  1,    false, &SearchConfig::depthDivisor, nullptr, nullptr},
+};
+const int SPSA_PARAM_COUNT = sizeof(SPSA_PARAMS) / sizeof(SPSA_PARAMS[0]);
+
+struct SpsaConfig {
+    int iterations = 200;
+    // Game pairs per iteration, each opening played with both colors
+    int pairs = (int) max(1u, thread::hardware_concurrency());
+    // Step of the first iteration for a full win, in first perturbations c of the parameter
+    double rate = 1;
+    SearchLimits limits;
+    int threads = (int) max(1u, thread::hardware_concurrency());
+    int report = 10;
+    unsigned long seed = 1;
+    string outPath;
+};
+
+// Play one game from the opening, returns the winner or c_empty for a draw
+template<int Size>
+Chess playGame(const vector<Coord> &opening, const SearchConfig &blackConfig, const SearchConfig &whiteConfig,
+               const SearchLimits &limits, const PatternLUT *lut, unsigned long seed) {
+    // Each engine searches its own board, with its own context so that their caches stay apart
+    BasicBoard<Size> board(seed), boards[2] = {BasicBoard<Size>(seed * 2 + 1), BasicBoard<Size>(seed * 2 + 2)};
+    const SearchConfig *configs[2] = {&blackConfig, &whiteConfig};
+    vector<BasicMinimaxAI<Size>> engines;
+    engines.reserve(2);
+    for (int p = 0; p < 2; ++p) {
+        if (lut != nullptr) boards[p].setWeights(lut);
+        engines.emplace_back(&boards[p], static_cast<Chess>(p));
+        engines.back().setConfig(*configs[p]);
+        engines.back().setLimits(limits);
+    }
+
+    Chess turn = black;
+    auto play = [&](int r, int c) {
+        board.set(r, c, turn);
+        boards[0].set(r, c, turn);
+        boards[1].set(r, c, turn);
+        turn = static_cast<Chess>(!turn);
+    };
+    for (auto m : opening) play(m.x, m.y);
+    while (!board.hasEnd() && board.getCount() < Size * Size) {
+        string buff;
+        auto p = engines[turn].calculate(&buff);
+        play(p.x, p.y);
+    }
+    return board.hasEnd() ? static_cast<Chess>(!turn) : c_empty;
+}
+
+string toJson(const SearchConfig &config) {
+    ostringstream out;
+    out << "{";
+    for (int i = 0; i < SPSA_PARAM_COUNT; ++i)
+        out << (i ? ", \"" : "\"") << SPSA_PARAMS[i].name << "\": " << SPSA_PARAMS[i].get(config);
+    out << "}";
+    return out.str();
+}
+
+/*
+ * Each iteration perturbs every parameter i by +-c_ik at random (delta_i), plays the two settings against each other
+ * and climbs the standard SPSA gradient estimate: theta_i += a_ik * (y+ - y-) / (2 * c_ik * delta_i), where y+ - y-
+ * is the score of plus minus the score of minus per game. c_ik = c_i / k^GAMMA and a_ik = 2 * rate * c_i^2 *
+ * ((A + 1) / (A + k))^ALPHA, so that a full win moves a parameter by rate * c_i on the first iteration, whatever its
+ * scale. The parameters are kept as reals and rounded when applied, integers are perturbed by at least half a unit so
+ * that both sides differ, and that is the c_ik of their estimate.
+ */
+template<int Size>
+int spsa(const vector<vector<Coord>> &openings, SearchConfig start, const SpsaConfig &config, const PatternLUT *lut) {
+    double theta[SPSA_PARAM_COUNT];
+    for (int i = 0; i < SPSA_PARAM_COUNT; ++i) theta[i] = SPSA_PARAMS[i].get(start);
+    mt19937_64 rng(config.seed);
+    // Stability constant of the gain schedule, a tenth of the iterations
+    const double bigA = 0.1 * config.iterations;
+    long long played = 0, nextOpening = 0;
+    double totalScore = 0;
+
+    auto current = [&]() {
+        SearchConfig res = start;
+        for (int i = 0; i < SPSA_PARAM_COUNT; ++i) SPSA_PARAMS[i].set(res, theta[i]);
+        return res;
+    };
+
+    for (int k = 1; k <= config.iterations; ++k) {
+        double ak = config.rate * pow(bigA + 1, ALPHA) / pow(bigA + k, ALPHA), ck = 1 / pow(k, GAMMA);
+        SearchConfig plus = start, minus = start;
+        int delta[SPSA_PARAM_COUNT];
+        double steps[SPSA_PARAM_COUNT];
+        for (int i = 0; i < SPSA_PARAM_COUNT; ++i) {
+            const auto &param = SPSA_PARAMS[i];
+            delta[i] = rng() % 2 ? 1 : -1;
+            steps[i] = param.c * ck;
+            if (param.integer) steps[i] = max(steps[i], 0.5);
+            param.set(plus, theta[i] + delta[i] * steps[i]);
+            param.set(minus, theta[i] - delta[i] * steps[i]);
+        }
+
+        // Game 2j and 2j + 1 share an opening, plus plays black in the first one
+        const int games = 2 * config.pairs;
+        atomic<int> next{0}, plusPoints{0};
+        auto worker = [&]() {
+            for (int g; (g = next++) < games;) {
+                bool plusBlack = g % 2 == 0;
+                const auto &opening = openings[(nextOpening + g / 2) % openings.size()];
+                auto winner = playGame<Size>(opening, plusBlack ? plus : minus, plusBlack ? minus : plus,
+                                             config.limits, lut, config.seed + played + g);
+                // Half points, so that draws count
+                plusPoints += winner == c_empty ? 1 : ((winner == black) == plusBlack ? 2 : 0);
+            }
+        };
+        vector<thread> pool;
+        for (int t = 0; t < min(config.threads, games); ++t) pool.emplace_back(worker);
+        for (auto &t : pool) t.join();
+        nextOpening += config.pairs;
+        played += games;
+
+        // Score of plus minus score of minus, per game in [-1, 1]
+        double result = (plusPoints - games) / (double) games;
+        totalScore += result;
+        for (int i = 0; i < SPSA_PARAM_COUNT; ++i) {
+            const auto &param = SPSA_PARAMS[i];
+            double gradient = result / (2 * steps[i] * delta[i]);
+            theta[i] = min(max(theta[i] + 2 * ak * param.c * param.c * gradient, param.lo), param.hi);
+        }
+
+        if (k % config.report == 0 || k == config.iterations) {
+            auto tuned = current();
+            cout << "{\"iteration\": " << k << ", \"games\": " << played << ", \"result\": " << result
+                 << ", \"average_result\": " << totalScore / k << ", \"a\": " << ak << ", \"c\": " << ck
+                 << ", \"params\": " << toJson(tuned) << "}" << endl;
+            // Written as it goes, so that a long run keeps its progress
+            if (!config.outPath.empty() && !tuned.save(config.outPath)) {
+                cerr << "Cannot write " << config.outPath << endl;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+vector<vector<Coord>> loadOpenings(const string &path) {
+    vector<vector<Coord>> res;
+    if (path.empty()) {
+        // The first moves of the recorded games
+        for (const char *game : RECORDED_GAMES) {
+            auto moves = parseMoves(game);
+            moves.resize(min((int) moves.size(), 3));
+            res.push_back(moves);
+        }
+        return res;
+    }
+    ifstream in(path);
+    string line;
+    while (getline(in, line))
+        if (!line.empty() && line[0] != '#') res.push_back(parseMoves(line.c_str()));
+    return res;
+}
+
+template<int Size>
+int run(const string &openingsPath, const SearchConfig &start, const SpsaConfig &config, const PatternLUT *lut) {
+    auto openings = loadOpenings(openingsPath);
+    if (openings.empty()) {
+        cerr << "No openings in " << openingsPath << endl;
+        return 1;
+    }
+    for (const auto &opening : openings)
+        for (auto m : opening)
+            if (m.x < 0 || m.y < 0 || m.x >= Size || m.y >= Size) {
+                cerr << "Opening move out of the board: " << m.x << "," << m.y << endl;
+                return 1;
+            }
+    return spsa<Size>(openings, start, config, lut);
+}
+
+/*
+ * Usage: Spsa [options]
+ * Tunes the search settings of SearchConfig (the opponent weight, the prune limit, the root window, the candidate
+ * limit, the checkmate depth and the depth divisor) by SPSA over self-play games on all cores, at the given search
+ * limits since most of them trade speed for accuracy. Prints one JSON line every --report iterations and writes the
+ * settings to --out, for search=FILE of LocalTest and --search of Bench.
+ * Options:
+ *   --out FILE              write the tuned settings, also during the run
+ *   --start FILE            start from the settings of a file instead of weight 0 and prune 10
+ *   --weights FILE          evaluate with the weights of a file, see PatternWeights.h, starting from its weight
+ *   --iterations N = 200    --pairs N = all cores (game pairs per iteration)
+ *   --rate R = 1            step of the first iteration for a full win, in perturbations c of each parameter
+ *   --depth N = 8           --time MS = 100     --nodes N = 0     --threads N = all cores
+ *   --openings FILE         one opening per line as "row,column" moves, defaults to the recorded games
+ *   --size 15 | 19 | 20     --report N = 10     --seed S = 1
+ */
+int main(int argc, char **argv) {
+    SpsaConfig config;
+    config.limits.timeMs = 100;
+    SearchConfig start;
+    start.weight = 0;
+    start.pruneLimit = 10;
+    EvalWeights weights;
+    unique_ptr<PatternLUT> lut;
+    string openingsPath;
+    int size = BOARD_SIZE;
+    for (int i = 1; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            cerr << "Missing value of " << argv[i] << endl;
+            return 1;
+        }
+        const char *value = argv[i + 1];
+        string error;
+        if (!strcmp(argv[i], "--out")) config.outPath = value;
+        else if (!strcmp(argv[i], "--start")) error = start.load(value);
+        else if (!strcmp(argv[i], "--weights")) {
+            error = weights.load(value);
+            lut = make_unique<PatternLUT>(weights.patterns);
+            start.weight = weights.weight;
+        } else if (!strcmp(argv[i], "--iterations")) config.iterations = max(1, atoi(value));
+        else if (!strcmp(argv[i], "--pairs")) config.pairs = max(1, atoi(value));
+        else if (!strcmp(argv[i], "--rate")) config.rate = atof(value);
+        else if (!strcmp(argv[i], "--depth")) config.limits.depth = atoi(value);
+        else if (!strcmp(argv[i], "--time")) config.limits.timeMs = atoi(value);
+        else if (!strcmp(argv[i], "--nodes")) config.limits.nodes = atoll(value);
+        else if (!strcmp(argv[i], "--threads")) config.threads = max(1, atoi(value));
+        else if (!strcmp(argv[i], "--openings")) openingsPath = value;
+        else if (!strcmp(argv[i], "--size")) size = atoi(value);
+        else if (!strcmp(argv[i], "--report")) config.report = max(1, atoi(value));
+        else if (!strcmp(argv[i], "--seed")) config.seed = strtoul(value, nullptr, 10);
+        else error = "unknown option";
+        if (!error.empty()) {
+            cerr << "Bad option " << argv[i] << " " << value << ": " << error << endl;
+            return 1;
+        }
+    }
+
+    switch (size) {
+        case 15:
+            return run<15>(openingsPath, start, config, lut.get());
+        case 19:
+            return run<19>(openingsPath, start, config, lut.get());
+        case 20:
+            return run<20>(openingsPath, start, config, lut.get());
+        default:
+            cerr << "Unsupported board size: " << size << endl;
+            return 1;
+    }
+}
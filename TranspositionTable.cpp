@@ -0,0 +1,130 @@
+#include "TranspositionTable.h"
+
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TranspositionTable::~TranspositionTable() {
+    close();
+}
+
+bool TranspositionTable::open(const std::string &path, unsigned long seed, int boardSize, bool canonicalHash,
+                              size_t entries) {
+    close();
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        m_error = "cannot open " + path;
+        return false;
+    }
+    return attach(fd, seed, boardSize, canonicalHash, entries);
+}
+
+bool TranspositionTable::openShared(const std::string &name, unsigned long seed, int boardSize, bool canonicalHash,
+                                    size_t entries) {
+    close();
+    int fd = shm_open(name.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        m_error = "cannot open " + name;
+        return false;
+    }
+    return attach(fd, seed, boardSize, canonicalHash, entries);
+}
+
+bool TranspositionTable::openPrivate(unsigned long seed, int boardSize, bool canonicalHash, size_t entries) {
+    close();
+    int fd = memfd_create("gomoku-tt", MFD_CLOEXEC);
+    if (fd < 0) {
+        m_error = "cannot create the memory of the table";
+        return false;
+    }
+    return attach(fd, seed, boardSize, canonicalHash, entries);
+}
+
+bool TranspositionTable::attach(int fd, unsigned long seed, int boardSize, bool canonicalHash, size_t entries) {
+    size_t n = 1;
+    while (n * 2 <= entries) n *= 2;
+    const size_t bytes = sizeof(Header) + n * sizeof(Entry);
+
+    // Processes opening the table at the same time wait for the first one to set it up
+    flock(fd, LOCK_EX);
+    struct stat st{};
+    if (fstat(fd, &st) != 0) return fail(fd, "cannot stat the table");
+    // Other processes may have an existing table mapped, it is never resized nor cleared
+    bool fresh = st.st_size == 0;
+    if (!fresh && (size_t) st.st_size != bytes)
+        return fail(fd, "the table has " + std::to_string(st.st_size) + " bytes, not " + std::to_string(bytes));
+    if (fresh && ftruncate(fd, (off_t) bytes) != 0) return fail(fd, "cannot size the table");
+    void *mem = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mem == MAP_FAILED) return fail(fd, "cannot map the table");
+
+    m_header = static_cast<Header *>(mem);
+    m_entries = reinterpret_cast<Entry *>(m_header + 1);
+    m_mask = n - 1;
+    m_bytes = bytes;
+
+    Header expected{};
+    memcpy(expected.magic, MAGIC, sizeof(MAGIC));
+    expected.version = VERSION;
+    expected.boardSize = boardSize;
+    expected.seed = seed;
+    expected.entries = n;
+    expected.canonicalHash = canonicalHash;
+    // A new table is zero-filled by ftruncate
+    if (fresh) {
+        *m_header = expected;
+    } else if (memcmp(m_header, &expected, sizeof(Header)) != 0) {
+        close();
+        return fail(fd, "the table was made with another version, board size, seed or hashing");
+    }
+    // The mapping stays valid without the descriptor, closing it releases the lock
+    ::close(fd);
+    return true;
+}
+
+bool TranspositionTable::fail(int fd, const std::string &error) {
+    ::close(fd);
+    m_error = error;
+    return false;
+}
+
+void TranspositionTable::close() {
+    if (m_header == nullptr) return;
+    munmap(m_header, m_bytes);
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_mask = m_bytes = 0;
+}
+
+unsigned long TranspositionTable::getSeed() const {
+    return m_header ? m_header->seed : 0;
+}
+
+bool TranspositionTable::probe(long key, CacheData &out) const {
+    const Entry &e = m_entries[key & m_mask];
+    uint64_t data = e.data.load(std::memory_order_relaxed);
+    if ((e.check.load(std::memory_order_relaxed) ^ data) != (uint64_t) key || data == 0) return false;
+    out.score = static_cast<int32_t>(data & 0xFFFFFFFFu);
+    out.depth = static_cast<int16_t>(data >> 32) - 1;
+    out.move = Coord(static_cast<short>((data >> 56) - 1), static_cast<short>((data >> 48 & 0xFF) - 1));
+    return true;
+}
+
+void TranspositionTable::store(long key, int score, int depth, Coord move) {
+    Entry &e = m_entries[key & m_mask];
+    CacheData old{};
+    if (probe(key, old) && old.depth > depth) return;
+    uint64_t data = static_cast<uint32_t>(score) | static_cast<uint64_t>(static_cast<uint16_t>(depth + 1)) << 32 |
+                    static_cast<uint64_t>(static_cast<uint8_t>(move.y + 1)) << 48 |
+                    static_cast<uint64_t>(static_cast<uint8_t>(move.x + 1)) << 56;
+    e.data.store(data, std::memory_order_relaxed);
+    e.check.store(key ^ data, std::memory_order_relaxed);
+}
+
+size_t TranspositionTable::count() const {
+    size_t res = 0;
+    for (size_t i = 0; i <= m_mask && m_entries; ++i) res += m_entries[i].data.load(std::memory_order_relaxed) != 0;
+    return res;
+}
@@ -0,0 +1,94 @@
+#ifndef GOMOKU_TRANSPOSITIONTABLE_H
+#define GOMOKU_TRANSPOSITIONTABLE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "constants.h"
+
+/*
+ * Cache of search results in a memory-mapped file, so that a restarted process continues with the results of the
+ * previous ones, or in POSIX shared memory, so that concurrent processes share their results.
+ * Keys are the board's cache keys, so every board using the table must be built with its seed.
+ * One entry per slot: a different key always replaces the entry, the same key only with a result as deep.
+ * Entries are updated without locks, the key is stored xor-ed with the data so that a torn entry reads as a miss.
+ */
+class TranspositionTable {
+public:
+    TranspositionTable() = default;
+
+    TranspositionTable(const TranspositionTable &) = delete;
+
+    TranspositionTable &operator=(const TranspositionTable &) = delete;
+
+    ~TranspositionTable();
+
+    /*
+     * Map the table stored at path, entries is rounded down to a power of 2. An empty file is set up as a new table.
+     * Returns false, see getError, if the file cannot be mapped or holds a table of other settings or size: other
+     * processes may use it, so it is left as it is.
+     */
+    bool open(const std::string &path, unsigned long seed, int boardSize, bool canonicalHash, size_t entries);
+
+    // Same as open, on the POSIX shared memory object name ("/name"), which outlives the processes until unlinked
+    bool openShared(const std::string &name, unsigned long seed, int boardSize, bool canonicalHash, size_t entries);
+
+    // Same as open, on memory of this process only, for a cache of bounded size
+    bool openPrivate(unsigned long seed, int boardSize, bool canonicalHash, size_t entries);
+
+    void close();
+
+    [[nodiscard]] bool isOpen() const { return m_entries != nullptr; }
+
+    [[nodiscard]] unsigned long getSeed() const;
+
+    // Why the last open failed
+    [[nodiscard]] const std::string &getError() const { return m_error; }
+
+    [[nodiscard]] bool probe(long key, CacheData &out) const;
+
+    void store(long key, int score, int depth, Coord move = Coord());
+
+    // Number of slots holding an entry
+    [[nodiscard]] size_t count() const;
+
+private:
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t boardSize;
+        uint64_t seed;
+        uint64_t entries;
+        uint32_t canonicalHash;
+        uint32_t reserved;
+    };
+
+    struct Entry {
+        // key ^ data, 0 marks an empty slot
+        std::atomic<uint64_t> check;
+        // Score in the low 32 bits, then depth + 1 in 16 bits, then the move as row + 1 and column + 1 in 8 bits
+        // each. The depth is offset so that no entry encodes to 0, the empty slot
+        std::atomic<uint64_t> data;
+    };
+
+    static_assert(sizeof(Entry) == 16 && std::atomic<uint64_t>::is_always_lock_free, "Entries must be lock-free");
+
+    static constexpr char MAGIC[8] = {'G', 'M', 'K', '-', 'T', 'T', '\0', '\0'};
+    static constexpr uint32_t VERSION = 6;
+
+    Header *m_header = nullptr;
+    Entry *m_entries = nullptr;
+    size_t m_mask = 0;
+    size_t m_bytes = 0;
+    std::string m_error;
+
+    // Map fd, setting up a new table if it is empty. Fails on a table of other settings or size
+    bool attach(int fd, unsigned long seed, int boardSize, bool canonicalHash, size_t entries);
+
+    // Close fd and keep error, returns false
+    bool fail(int fd, const std::string &error);
+};
+
+
+#endif //GOMOKU_TRANSPOSITIONTABLE_H
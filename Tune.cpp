@@ -0,0 +1,357 @@
+#include "Board.h"
+#include "GameRecord.h"
+#include "PatternWeights.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <thread>
+
+using namespace std;
+
+// Patterns whose weights are tuned, the ones between empty and five
+const int FIRST_TUNED = p_1m, TUNED_COUNT = p_5 - p_1m;
+// Parameters of the model: the log weights of the tuned patterns, then the opponent weight
+const int PARAM_COUNT = TUNED_COUNT + 1;
+
+// A position: pattern counts of the side to move and of its opponent, and the result of the game for the side to move
+struct Sample {
+    int16_t own[TUNED_COUNT], opponent[TUNED_COUNT];
+    float result;
+};
+
+struct TuneConfig {
+    // Plies of each game skipped, openings say little about the result
+    int skipPlies = 4;
+    // Every holdout-th game is kept out of the fit to measure it, 0 for none
+    int holdout = 10;
+    int epochs = 300;
+    // Positions per step, 0 for all of them
+    int batch = 0;
+    double rate = 0.05;
+    bool tuneWeight = true;
+    int threads = (int) max(1u, thread::hardware_concurrency());
+    int report = 10;
+    unsigned long seed = 1;
+};
+
+// Run fn(thread, begin, end) over [0, n) split into one range per thread
+void parallelFor(int threads, size_t n, const function<void(int, size_t, size_t)> &fn) {
+    threads = (int) max<size_t>(1, min<size_t>(threads, n));
+    vector<thread> pool;
+    for (int t = 0; t < threads; ++t) pool.emplace_back(fn, t, n * t / threads, n * (t + 1) / threads);
+    for (auto &t : pool) t.join();
+}
+
+/*
+ * Replay the games into samples, the positions of every holdout-th game into validation. MinimaxAI evaluates from the
+ * side to move, so each position gives a sample of that side.
+ * Positions where the side to move has a four are skipped: they are won in one move, which is up to the search.
+ */
+template<int Size>
+void extract(const vector<GameView> &games, const TuneConfig &config, vector<Sample> &train,
+             vector<Sample> &validation) {
+    vector<vector<Sample>> parts(2 * config.threads);
+    parallelFor(config.threads, games.size(), [&](int t, size_t begin, size_t end) {
+        BasicBoard<Size> board(1);
+        int counts[2][PATTERN_COUNT];
+        for (size_t g = begin; g < end; ++g) {
+            const auto &game = games[g];
+            auto &out = parts[2 * t + (config.holdout > 0 && (int) (g % config.holdout) == config.holdout - 1)];
+            board.load({});
+            for (int i = 0; i < game.size() && !board.hasEnd(); ++i) {
+                auto side = i % 2 ? white : black;
+                if (i >= config.skipPlies) {
+                    board.countPatterns(side, counts[0]);
+                    board.countPatterns(static_cast<Chess>(!side), counts[1]);
+                    if (counts[0][p_4m] + counts[0][p_4p] == 0) {
+                        Sample s{};
+                        for (int k = 0; k < TUNED_COUNT; ++k) {
+                            s.own[k] = (int16_t) counts[0][FIRST_TUNED + k];
+                            s.opponent[k] = (int16_t) counts[1][FIRST_TUNED + k];
+                        }
+                        s.result = game.winner() == c_empty ? 0.5f : (game.winner() == side ? 1.f : 0.f);
+                        out.push_back(s);
+#ifndef NDEBUG
+                        int score = 0;
+                        for (int k = 0; k < PATTERN_COUNT; ++k) score += PATTERN_SCORE[k] * counts[0][k];
+                        assert(score == board.getScore(side));
+#endif
+                    }
+                }
+                auto m = game.move(i);
+                board.set(m.x, m.y, side);
+            }
+        }
+    });
+    for (size_t p = 0; p < parts.size(); ++p)
+        (p % 2 ? validation : train).insert((p % 2 ? validation : train).end(), parts[p].begin(), parts[p].end());
+}
+
+/*
+ * Logistic model of the result: the evaluation of MinimaxAI, sum of w_k * (own_k - (1 - weight) * opponent_k),
+ * scaled by k into the log-odds of a win. The weights are tuned through their logs, which keeps them positive and
+ * makes a step change them by a ratio, as their magnitudes are far apart.
+ */
+struct Model {
+    double params[PARAM_COUNT];
+    double k = 1e-3;
+
+    explicit Model(const EvalWeights &weights) {
+        for (int i = 0; i < TUNED_COUNT; ++i) params[i] = log(max(1, weights.patterns[FIRST_TUNED + i]));
+        params[TUNED_COUNT] = weights.weight;
+    }
+
+    [[nodiscard]] EvalWeights weights() const {
+        EvalWeights res;
+        for (int i = 0; i < TUNED_COUNT; ++i)
+            res.patterns[FIRST_TUNED + i] = (int) min<double>(round(exp(params[i])), MAX_PATTERN_WEIGHT);
+        res.weight = (float) params[TUNED_COUNT];
+        return res;
+    }
+
+    void clamp() {
+        for (int i = 0; i < TUNED_COUNT; ++i) params[i] = min(max(params[i], 0.), log((double) MAX_PATTERN_WEIGHT));
+        params[TUNED_COUNT] = min(max(params[TUNED_COUNT], 0.), 1.);
+    }
+};
+
+/*
+ * Mean cross-entropy of the model over samples[index[begin, end)], or over samples[begin, end) without an index.
+ * Adds its gradient to grad unless it is null.
+ */
+double loss(const Model &model, const vector<Sample> &samples, const vector<uint32_t> *index, size_t begin,
+            size_t end, int threads, double *grad) {
+    if (begin >= end) return 0;
+    double w[TUNED_COUNT];
+    for (int i = 0; i < TUNED_COUNT; ++i) w[i] = exp(model.params[i]);
+    const double keep = 1 - model.params[TUNED_COUNT];
+
+    // Loss then gradient of each thread, summed once they are done
+    vector<array<double, PARAM_COUNT + 1>> sums(threads);
+    parallelFor(threads, end - begin, [&](int t, size_t from, size_t to) {
+        array<double, PARAM_COUNT + 1> sum{};
+        for (size_t j = begin + from; j < begin + to; ++j) {
+            const auto &s = samples[index != nullptr ? (*index)[j] : j];
+            double e = 0, opponent = 0;
+            for (int i = 0; i < TUNED_COUNT; ++i) {
+                e += w[i] * s.own[i];
+                opponent += w[i] * s.opponent[i];
+            }
+            double z = model.k * (e - keep * opponent);
+            // softplus(z) - result * z, without overflow
+            sum[0] += max(z, 0.) + log1p(exp(-fabs(z))) - s.result * z;
+            if (grad == nullptr) continue;
+            double d = model.k * (1 / (1 + exp(-z)) - s.result);
+            for (int i = 0; i < TUNED_COUNT; ++i) sum[1 + i] += d * w[i] * (s.own[i] - keep * s.opponent[i]);
+            sum[1 + TUNED_COUNT] += d * opponent;
+        }
+        sums[t] = sum;
+    });
+
+    double n = (double) (end - begin), res = 0;
+    for (const auto &sum : sums) {
+        res += sum[0];
+        if (grad != nullptr)
+            for (int i = 0; i < PARAM_COUNT; ++i) grad[i] += sum[1 + i] / n;
+    }
+    return res / n;
+}
+
+double loss(const Model &model, const vector<Sample> &samples, int threads) {
+    return loss(model, samples, nullptr, 0, samples.size(), threads, nullptr);
+}
+
+// Golden section search of the k of the smallest loss, over its log
+void fitScale(Model &model, const vector<Sample> &samples, int threads) {
+    const double phi = (sqrt(5.) - 1) / 2;
+    double lo = log(1e-7), hi = log(1.);
+    for (int i = 0; i < 40; ++i) {
+        double a = hi - phi * (hi - lo), b = lo + phi * (hi - lo);
+        model.k = exp(a);
+        double la = loss(model, samples, threads);
+        model.k = exp(b);
+        double lb = loss(model, samples, threads);
+        (la < lb ? hi : lo) = la < lb ? b : a;
+    }
+    model.k = exp((lo + hi) / 2);
+}
+
+string toJson(const EvalWeights &weights) {
+    ostringstream out;
+    out << "{";
+    for (int i = p_empty + 1; i < p_5; ++i)
+        out << (i > p_empty + 1 ? ", \"" : "\"") << PATTERN_NAMES[i] << "\": " << weights.patterns[i];
+    out << ", \"weight\": " << weights.weight << "}";
+    return out.str();
+}
+
+void report(int epoch, const Model &model, const vector<Sample> &train, const vector<Sample> &validation,
+            int threads) {
+    cout << "{\"epoch\": " << epoch << ", \"loss\": " << loss(model, train, threads);
+    if (!validation.empty()) cout << ", \"validation_loss\": " << loss(model, validation, threads);
+    cout << ", \"weights\": " << toJson(model.weights()) << "}" << endl;
+}
+
+// Adam over the parameters, in batches of the shuffled positions
+Model fit(Model model, const vector<Sample> &train, const vector<Sample> &validation, const TuneConfig &config) {
+    const double beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+    double m[PARAM_COUNT] = {}, v[PARAM_COUNT] = {};
+    const size_t batch = config.batch > 0 ? min<size_t>(config.batch, train.size()) : train.size();
+    vector<uint32_t> index(train.size());
+    for (size_t i = 0; i < index.size(); ++i) index[i] = (uint32_t) i;
+    mt19937_64 rng(config.seed);
+
+    long long step = 0;
+    for (int epoch = 1; epoch <= config.epochs; ++epoch) {
+        if (batch < train.size()) shuffle(index.begin(), index.end(), rng);
+        for (size_t begin = 0; begin + batch <= train.size(); begin += batch) {
+            double grad[PARAM_COUNT] = {};
+            loss(model, train, &index, begin, begin + batch, config.threads, grad);
+            if (!config.tuneWeight) grad[TUNED_COUNT] = 0;
+            step++;
+            for (int i = 0; i < PARAM_COUNT; ++i) {
+                m[i] = beta1 * m[i] + (1 - beta1) * grad[i];
+                v[i] = beta2 * v[i] + (1 - beta2) * grad[i] * grad[i];
+                double mHat = m[i] / (1 - pow(beta1, step)), vHat = v[i] / (1 - pow(beta2, step));
+                model.params[i] -= config.rate * mHat / (sqrt(vHat) + eps);
+            }
+            model.clamp();
+        }
+        if (config.report > 0 && (epoch % config.report == 0 || epoch == config.epochs))
+            report(epoch, model, train, validation, config.threads);
+    }
+    return model;
+}
+
+template<int Size>
+int run(const vector<unique_ptr<GameRecordReader>> &readers, EvalWeights initial, const TuneConfig &config,
+        const string &outPath) {
+    auto startT = Clock::now();
+    vector<GameView> games;
+    for (const auto &reader : readers) {
+        size_t offset = reader->begin();
+        GameView game;
+        while (reader->next(offset, game)) games.push_back(game);
+    }
+    vector<Sample> train, validation;
+    extract<Size>(games, config, train, validation);
+    if (train.empty()) {
+        cerr << "No positions to tune on" << endl;
+        return 1;
+    }
+
+    Model model(initial);
+    fitScale(model, train, config.threads);
+    cout << "{\"games\": " << games.size() << ", \"positions\": " << train.size() << ", \"validation_positions\": "
+         << validation.size() << ", \"k\": " << model.k << ", \"extract_ms\": " << MS_DIFF(startT, Clock::now())
+         << "}" << endl;
+    report(0, model, train, validation, config.threads);
+
+    auto fitT = Clock::now();
+    model = fit(model, train, validation, config);
+    auto weights = model.weights();
+    // The loss of the weights as written, rounded to integers
+    Model rounded(weights);
+    rounded.k = model.k;
+    cout << "{\"loss\": " << loss(rounded, train, config.threads);
+    if (!validation.empty()) cout << ", \"validation_loss\": " << loss(rounded, validation, config.threads);
+    cout << ", \"weights\": " << toJson(weights) << ", \"fit_ms\": " << MS_DIFF(fitT, Clock::now()) << "}" << endl;
+
+    if (!outPath.empty() && !weights.save(outPath)) {
+        cerr << "Cannot write " << outPath << endl;
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Usage: Tune RECORDS... [options]
+ * Fits the pattern weights and the opponent weight of the evaluation to the results of the freestyle games of record
+ * files (see GameRecord.h), minimising the cross-entropy of a logistic model of the result over the evaluation of
+ * each position from the side to move. Prints JSON progress lines and writes the weights for --weights of the other
+ * tools.
+ * Options:
+ *   --out FILE              write the tuned weights, see PatternWeights.h
+ *   --weights FILE          start from the weights of a file instead of the compiled ones
+ *   --epochs N = 300        --batch N = 0 (all positions)    --rate R = 0.05    --threads N = all cores
+ *   --skip-plies N = 4      --holdout N = 10 (every Nth game validates, 0 for none)
+ *   --fixed-weight          keep the opponent weight      --report N = 10     --seed S = 1
+ */
+int main(int argc, char **argv) {
+    TuneConfig config;
+    EvalWeights initial;
+    string outPath;
+    vector<unique_ptr<GameRecordReader>> readers;
+    for (int i = 1; i < argc; ++i) {
+        if (!strcmp(argv[i], "--fixed-weight")) {
+            config.tuneWeight = false;
+            continue;
+        }
+        if (argv[i][0] != '-') {
+            readers.push_back(make_unique<GameRecordReader>());
+            if (!readers.back()->open(argv[i])) {
+                cerr << "Not a game record file: " << argv[i] << endl;
+                return 1;
+            }
+            // The evaluation is of freestyle, where an overline wins: other games would teach it wrong patterns
+            if (readers.back()->getRule() != rule_freestyle) {
+                cerr << "Records of another rule than freestyle: " << argv[i] << endl;
+                return 1;
+            }
+            if (readers.back()->getBoardSize() != readers.front()->getBoardSize()) {
+                cerr << "Records of different board sizes" << endl;
+                return 1;
+            }
+            continue;
+        }
+        if (i + 1 == argc) {
+            cerr << "Missing value of " << argv[i] << endl;
+            return 1;
+        }
+        const char *value = argv[++i];
+        if (!strcmp(argv[i - 1], "--out")) outPath = value;
+        else if (!strcmp(argv[i - 1], "--weights")) {
+            auto error = initial.load(value);
+            if (!error.empty()) {
+                cerr << "Bad weights: " << error << endl;
+                return 1;
+            }
+        } else if (!strcmp(argv[i - 1], "--epochs")) config.epochs = atoi(value);
+        else if (!strcmp(argv[i - 1], "--batch")) config.batch = atoi(value);
+        else if (!strcmp(argv[i - 1], "--rate")) config.rate = atof(value);
+        else if (!strcmp(argv[i - 1], "--threads")) config.threads = max(1, atoi(value));
+        else if (!strcmp(argv[i - 1], "--skip-plies")) config.skipPlies = atoi(value);
+        else if (!strcmp(argv[i - 1], "--holdout")) config.holdout = max(0, atoi(value));
+        else if (!strcmp(argv[i - 1], "--report")) config.report = atoi(value);
+        else if (!strcmp(argv[i - 1], "--seed")) config.seed = strtoul(value, nullptr, 10);
+        else {
+            cerr << "Unknown option " << argv[i - 1] << endl;
+            return 1;
+        }
+    }
+    if (readers.empty()) {
+        cerr << "Usage: Tune RECORDS... [--out FILE] [options]" << endl;
+        return 1;
+    }
+
+    switch (readers.front()->getBoardSize()) {
+        case 15:
+            return run<15>(readers, initial, config, outPath);
+        case 19:
+            return run<19>(readers, initial, config, outPath);
+        case 20:
+            return run<20>(readers, initial, config, outPath);
+        default:
+            cerr << "Unsupported board size: " << readers.front()->getBoardSize() << endl;
+            return 1;
+    }
+}
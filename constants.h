@@ -14,6 +14,9 @@ typedef std::chrono::high_resolution_clock Clock;
 
 
 const int BOARD_SIZE = 15;
+
+// Cells per stored row: at least one spare cell, rounded up to a multiple of 8 for the vector kernels
+constexpr int rowStride(int size) { return (size + 8) / 8 * 8; }
 const int SCORE_RANGE = 5;
 const int TIME_LIMIT = 990;
 // const int TIME_LIMIT = 5000;
@@ -21,8 +24,9 @@ const int MINIMAX_DEPTH = 8;
 const int CHECKMATE_DEPTH = 4;
 
 
-enum Chess {
-    c_empty = -1, black = 0, white = 1
+enum Chess : signed char {
+    // c_edge only marks the border cells of the padded board
+    c_empty = -1, black = 0, white = 1, c_edge = 2
 };
 
 enum Direction {
@@ -45,6 +49,13 @@ enum Forms {
     _empty = 0
 };
 
+// Pattern ids stored for each cell & direction, PATTERN_SCORE maps them to their Forms weight
+enum Pattern : unsigned char {
+    p_empty = 0, p_1m, p_1p, p_2m, p_2p_spaced, p_2p, p_3m, p_3p, p_4m, p_4p, p_5, PATTERN_COUNT
+};
+
+const int PATTERN_SCORE[PATTERN_COUNT] = {_empty, _1m, _1p, _2m, _2p_spaced, _2p, _3m, _3p, _4m, _4p, _5};
+
 struct Point {
     short x, y;
 
@@ -58,10 +69,6 @@ struct Point {
 };
 
 
-struct MinimaxNode {
-    int score, depth;
-};
-
 struct Coord {
     short x, y;
 
@@ -71,17 +78,9 @@ struct Coord {
 };
 
 struct CacheData {
-    MinimaxNode *minimaxNode;
-
-    explicit CacheData(int score, int depth) {
-        minimaxNode = new MinimaxNode;
-        minimaxNode->score = score;
-        minimaxNode->depth = depth;
-    }
-
-    ~CacheData() {
-        delete minimaxNode;
-    }
+    int score, depth;
+    // Best move found, (-1, -1) if none
+    Coord move;
 };
 
 
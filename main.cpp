@@ -1,52 +1,134 @@
 #include "MinimaxAI.cpp"
 #include "Board.cpp"
+#include "TranspositionTable.cpp"
+#include "BotzoneIO.h"
+#include "PatternWeights.h"
 #include "jsoncpp/json.h"
 
+// Fallback for the inputs BotzoneReader does not understand
+bool readBotzoneJson(const string &line, BotzoneInput &input) {
+    Json::Reader reader;
+    Json::Value root;
+    if (!reader.parse(line, root) || !root.isObject()) return false;
+
+    auto toMoves = [](const Json::Value &list, vector<Coord> &moves) {
+        moves.clear();
+        for (const auto &m : list) moves.emplace_back(m["x"].asInt(), m["y"].asInt());
+    };
+    input.full = root.isMember("requests");
+    if (input.full) {
+        toMoves(root["requests"], input.requests);
+        toMoves(root["responses"], input.responses);
+    } else {
+        input.requests.assign(1, Coord(root["x"].asInt(), root["y"].asInt()));
+        input.responses.clear();
+    }
+    return !input.requests.empty();
+}
+
+// Answer every turn in one process. Set to false for Botzone's simple interaction, where the bot is restarted each
+// turn with the whole history
+const bool KEEP_RUNNING = true;
+
+// Moves of a full input in play order, black first, leaving out the (-1, -1) first request of black
+vector<Coord> history(const BotzoneInput &input) {
+    vector<Coord> moves;
+    for (size_t i = 0; i < input.requests.size(); ++i) {
+        if (input.requests[i].x >= 0 && input.requests[i].y >= 0) moves.push_back(input.requests[i]);
+        if (i < input.responses.size()) moves.push_back(input.responses[i]);
+    }
+    return moves;
+}
+
+// Keep the cache in this file between runs, "" for the in-memory cache. Useful in the simple interaction, where
+// every turn would otherwise start with an empty cache
+const char *const TT_FILE = "";
+// Or share the cache with the other bots on the host in this POSIX shared memory object, e.g. "/gomoku-tt"
+const char *const TT_SHARED = "";
+const size_t TT_ENTRIES = 1 << 22;
+// Zobrist seed of a board using the table. A table of another seed or size is left alone, the bot then falls back on
+// the in-memory cache
+const unsigned long TT_SEED = 20210508;
+
+// Evaluation weights written by Tune and search settings written by Spsa, "" for the built-in ones. A file that does
+// not load leaves the built-in ones
+const char *const WEIGHTS_FILE = "";
+const char *const SEARCH_FILE = "";
+
 int main() {
-    Board b();
+    EvalWeights weights;
+    SearchConfig search;
+    search.weight = 0;
+    search.pruneLimit = 10;
+    if (WEIGHTS_FILE[0]) {
+        EvalWeights loaded;
+        auto error = loaded.load(WEIGHTS_FILE);
+        if (error.empty()) weights = loaded, search.weight = loaded.weight;
+        else cerr << "Built-in weights kept: " << error << endl;
+    }
+    if (SEARCH_FILE[0]) {
+        SearchConfig loaded = search;
+        auto error = loaded.load(SEARCH_FILE);
+        if (error.empty()) search = loaded;
+        else cerr << "Built-in search settings kept: " << error << endl;
+    }
+    const PatternLUT lut(weights.patterns);
+
+    TranspositionTable table;
+    bool persistent = TT_SHARED[0] ? table.openShared(TT_SHARED, TT_SEED, BOARD_SIZE, true, TT_ENTRIES)
+                                   : TT_FILE[0] && table.open(TT_FILE, TT_SEED, BOARD_SIZE, true, TT_ENTRIES);
+    Board b(persistent ? TT_SEED : time(nullptr));
+    b.setCanonicalHashing(true);
+    b.setWeights(&lut);
     MinimaxAI *ai = nullptr;
     Chess identity;
-    Json::Reader reader;
 
-    bool first = true;
+    string line;
+    BotzoneInput input;
 
-    while (1) {
-        string str;
-        getline(cin, str);
-        Json::Value input;
-        reader.parse(str, input);
+    // The judge waits for a reply to every request, so a bad one is still answered
+    auto reply = [&](int x, int y, const string &msg) {
+        writeBotzoneResponse(stdout, x, y, b.getScore(black), b.getScore(white), msg);
+        if (!KEEP_RUNNING) return false;
+        fputs(">>>BOTZONE_REQUEST_KEEP_RUNNING<<<\n", stdout);
+        fflush(stdout);
+        return true;
+    };
+    auto reject = [&](const string &msg) {
+        cerr << msg << ": " << line << endl;
+        return reply(-1, -1, msg);
+    };
+
+    while (getline(cin, line)) {
+        if (line.empty()) continue;
+        if (!BotzoneReader(line.data(), line.data() + line.size()).read(input) && !readBotzoneJson(line, input)) {
+            if (!reject("cannot parse the request")) break;
+            continue;
+        }
 
-        int x, y;
-        if (first) {
-            x = input["requests"][0]["x"].asInt();
-            y = input["requests"][0]["y"].asInt();
-            ai = new MinimaxAI(&b, identity = (x < 0 && y < 0 ? black : white), 0, 10);
-            first = false;
+        if (input.full) {
+            // First turn, or every turn in the simple interaction: load the whole game at once
+            if (ai == nullptr) {
+                identity = input.requests[0].x < 0 && input.requests[0].y < 0 ? black : white;
+                ai = new MinimaxAI(&b, identity);
+                ai->setConfig(search);
+                if (persistent) ai->getContext()->setTable(&table);
+                // The board seed is fixed with a table, keep the first move random
+                ai->setSeed(time(nullptr));
+            }
+            b.load(history(input));
+        } else if (ai != nullptr) {
+            int x = input.requests[0].x, y = input.requests[0].y;
+            if (x >= 0 && y >= 0) b.set(x, y, static_cast<Chess>(!identity));
         } else {
-            x = input["x"].asInt();
-            y = input["y"].asInt();
+            if (!reject("the first request must carry the whole game")) break;
+            continue;
         }
 
-        if (x >= 0 && y >= 0) b.set(x, y, static_cast<Chess>(!identity));
         string buff;
         auto res = ai->calculate(&buff);
         b.set(res.x, res.y, identity);
 
-        Json::Value response;
-        response["x"] = res.x;
-        response["y"] = res.y;
-
-        Json::Value debug;
-        debug["_b"] = b.getScore(black);
-        debug["_w"] = b.getScore(white);
-        debug["msg"] = buff;
-
-        Json::Value ret;
-        ret["response"] = response;
-        ret["debug"] = debug;
-        Json::FastWriter writer;
-        cout << writer.write(ret) << endl;
-        cout << ">>>BOTZONE_REQUEST_KEEP_RUNNING<<<" << endl;
-        fflush(stdout);
+        if (!reply(res.x, res.y, buff)) break;
     }
 }
@@ -1,15 +1,31 @@
 #include "Board.h"
+#include "GameRecord.h"
 #include "MinimaxAI.h"
+#include "PatternKernel.h"
+#include "PatternWeights.h"
+#include "RecordedGames.h"
 
+#include <atomic>
+#include <cmath>
+#include <cstring>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
 using namespace std;
 
-int main() {
-    auto *b = new Board(), *b1 = new Board(), *b2 = new Board();
-    MinimaxAI ai_b(b1, black, 0, 10);
-    MinimaxAI ai_w(b1, white, 0, 10);
+template<int Size>
+void selfPlay() {
+    auto *b = new BasicBoard<Size>(), *b1 = new BasicBoard<Size>(), *b2 = new BasicBoard<Size>();
+    BasicMinimaxAI<Size> ai_b(b1, black, 0, 10);
+    BasicMinimaxAI<Size> ai_w(b1, white, 0, 10);
+    ai_w.setContext(ai_b.getContext());
     // MctAI ai_w(b2, white);
+    ai_b.setPrintStats(true);
+    ai_w.setPrintStats(true);
 
     string t;
     while (!b->hasEnd()) {
@@ -35,5 +51,288 @@ int main() {
         printf("Current: black = %d, white = %d\n", b->getScore(black), b->getScore(white));
         // cin >> t;
     }
-    std::cout << b1->getCachedSize() << std::endl;
+    std::cout << ai_b.getContext()->getCachedSize() << std::endl;
+}
+
+/* Tournament */
+
+// Settings of one side of a tournament, parsed from "key=value,key=value"
+struct EngineConfig {
+    SearchConfig search;
+    SearchLimits limits;
+    bool canonicalHash = false;
+    // Pattern weights of the engine's board, PATTERN_LUT if null
+    shared_ptr<const PatternLUT> lut;
+
+    EngineConfig() {
+        search.weight = 0;
+        search.pruneLimit = 10;
+    }
+
+    bool parse(const string &spec) {
+        stringstream in(spec);
+        string item;
+        while (getline(in, item, ',')) {
+            auto eq = item.find('=');
+            if (eq == string::npos) return false;
+            string key = item.substr(0, eq);
+            // Sets the weight too, a later weight key overrides it
+            if (key == "weights") {
+                EvalWeights weights;
+                auto error = weights.load(item.substr(eq + 1));
+                if (!error.empty()) {
+                    std::cerr << "Bad weights: " << error << std::endl;
+                    return false;
+                }
+                lut = make_shared<PatternLUT>(weights.patterns);
+                search.weight = weights.weight;
+                continue;
+            }
+            // All settings of a file of Spsa, later keys override them
+            if (key == "search") {
+                auto error = search.load(item.substr(eq + 1));
+                if (!error.empty()) {
+                    std::cerr << "Bad search settings: " << error << std::endl;
+                    return false;
+                }
+                continue;
+            }
+            double value = atof(item.c_str() + eq + 1);
+            if (key == "weight") search.weight = (float) value;
+            else if (key == "prune") search.pruneLimit = (int) value;
+            else if (key == "depth") limits.depth = (int) value;
+            else if (key == "time") limits.timeMs = (int) value;
+            else if (key == "nodes") limits.nodes = (long long) value;
+            else if (key == "sym") canonicalHash = value != 0;
+            else return false;
+        }
+        return true;
+    }
+};
+
+struct TournamentResult {
+    // From the view of engine A
+    int wins = 0, draws = 0, losses = 0;
+
+    [[nodiscard]] int games() const { return wins + draws + losses; }
+
+    [[nodiscard]] double score() const { return games() ? (wins + draws / 2.) / games() : 0.5; }
+
+    // Variance of the score of one game
+    [[nodiscard]] double variance() const {
+        double m = score();
+        return games() ? (wins * (1 - m) * (1 - m) + draws * (.5 - m) * (.5 - m) + losses * m * m) / games() : 0;
+    }
+
+    static double elo(double score) {
+        score = min(max(score, 1e-6), 1 - 1e-6);
+        return -400 * log10(1 / score - 1);
+    }
+
+    // Log-likelihood ratio of elo1 against elo0, normal approximation of the trinomial model
+    [[nodiscard]] double llr(double elo0, double elo1) const {
+        double var = variance();
+        if (var <= 0) return 0;
+        double s0 = 1 / (1 + pow(10, -elo0 / 400)), s1 = 1 / (1 + pow(10, -elo1 / 400));
+        return games() * (s1 - s0) * (2 * score() - s0 - s1) / (2 * var);
+    }
+};
+
+// Play one game from the opening, returns the winner or c_empty for a draw. Fills the moves and their search results
+template<int Size>
+Chess playGame(const vector<Coord> &opening, const EngineConfig &blackConfig, const EngineConfig &whiteConfig,
+               unsigned long seed, vector<Coord> &moves, vector<MoveInfo> &info) {
+    // Each engine searches its own board, with its own context so that their caches stay apart
+    BasicBoard<Size> board(seed), boards[2] = {BasicBoard<Size>(seed * 2 + 1), BasicBoard<Size>(seed * 2 + 2)};
+    const EngineConfig *configs[2] = {&blackConfig, &whiteConfig};
+    vector<BasicMinimaxAI<Size>> engines;
+    engines.reserve(2);
+    for (int p = 0; p < 2; ++p) {
+        boards[p].setCanonicalHashing(configs[p]->canonicalHash);
+        if (configs[p]->lut != nullptr) boards[p].setWeights(configs[p]->lut.get());
+        engines.emplace_back(&boards[p], static_cast<Chess>(p));
+        engines.back().setConfig(configs[p]->search);
+        engines.back().setLimits(configs[p]->limits);
+    }
+
+    moves.clear();
+    info.clear();
+    auto play = [&](int r, int c, Chess player) {
+        board.set(r, c, player);
+        boards[0].set(r, c, player);
+        boards[1].set(r, c, player);
+        moves.emplace_back(r, c);
+        info.emplace_back();
+    };
+    Chess turn = black;
+    for (auto m : opening) {
+        play(m.x, m.y, turn);
+        turn = static_cast<Chess>(!turn);
+    }
+    while (!board.hasEnd() && board.getCount() < Size * Size) {
+        string buff;
+        auto p = engines[turn].calculate(&buff);
+        play(p.x, p.y, turn);
+        const auto &stats = engines[turn].getStats();
+        info.back().score = p.ai_score;
+        info.back().timeMs = (uint16_t) min(stats.timeMs, 0xFFFFll);
+        for (const auto &it : stats.iterations)
+            if (it.completed) info.back().depth = (uint8_t) it.depth;
+        turn = static_cast<Chess>(!turn);
+    }
+    return board.hasEnd() ? static_cast<Chess>(!turn) : c_empty;
+}
+
+/*
+ * Plays engine A against engine B from every opening twice, with colors swapped, on all threads.
+ * Stops once all games are played or the SPRT of elo1 against elo0 accepts either one.
+ */
+template<int Size>
+int tournament(const vector<vector<Coord>> &openings, const EngineConfig &a, const EngineConfig &b, int maxGames,
+               int threads, double elo0, double elo1, GameRecordWriter *record) {
+    const double alpha = 0.05, beta = 0.05;
+    const double lower = log(beta / (1 - alpha)), upper = log((1 - beta) / alpha);
+
+    TournamentResult result;
+    mutex resultMutex;
+    atomic<int> next{0};
+    atomic<bool> stop{false};
+
+    auto worker = [&]() {
+        vector<Coord> moves;
+        vector<MoveInfo> info;
+        for (int g; !stop && (g = next++) < maxGames;) {
+            // Game 2k and 2k + 1 share an opening, A plays black in the first one
+            const auto &opening = openings[(g / 2) % openings.size()];
+            bool aBlack = g % 2 == 0;
+            auto winner = playGame<Size>(opening, aBlack ? a : b, aBlack ? b : a, g + 1, moves, info);
+
+            lock_guard<mutex> lock(resultMutex);
+            if (record != nullptr) record->write(moves, winner, info);
+            if (winner == c_empty) result.draws++;
+            else if ((winner == black) == aBlack) result.wins++;
+            else result.losses++;
+
+            double llr = result.llr(elo0, elo1), score = result.score();
+            // 95% interval of the score, mapped to elo
+            double margin = 1.96 * sqrt(result.variance() / result.games());
+            double eloError = (TournamentResult::elo(score + margin) - TournamentResult::elo(score - margin)) / 2;
+            printf("Game %d: %s; +%d =%d -%d, score %.3f, elo %.1f +- %.1f, LLR %.2f [%.2f, %.2f]\n", g + 1,
+                   winner == c_empty ? "draw" : ((winner == black) == aBlack ? "A wins" : "B wins"),
+                   result.wins, result.draws, result.losses, score, TournamentResult::elo(score), eloError,
+                   llr, lower, upper);
+            fflush(stdout);
+            if (llr <= lower || llr >= upper) stop = true;
+        }
+    };
+    vector<thread> pool;
+    for (int t = 0; t < threads; ++t) pool.emplace_back(worker);
+    for (auto &t : pool) t.join();
+
+    double llr = result.llr(elo0, elo1);
+    if (llr >= upper) printf("SPRT: H1 accepted, A is at least %.1f elo stronger\n", elo1);
+    else if (llr <= lower) printf("SPRT: H0 accepted, A is not %.1f elo stronger\n", elo1);
+    else printf("SPRT: inconclusive after %d games\n", result.games());
+    return 0;
+}
+
+vector<vector<Coord>> loadOpenings(const string &path) {
+    vector<vector<Coord>> res;
+    if (path.empty()) {
+        // The first moves of the recorded games
+        for (const char *game : RECORDED_GAMES) {
+            auto moves = parseMoves(game);
+            moves.resize(min((int) moves.size(), 3));
+            res.push_back(moves);
+        }
+        return res;
+    }
+    ifstream in(path);
+    string line;
+    while (getline(in, line))
+        if (!line.empty() && line[0] != '#') res.push_back(parseMoves(line.c_str()));
+    return res;
+}
+
+template<int Size>
+int run(int argc, char **argv) {
+    if (argc < 2 || strcmp(argv[1], "--tournament") != 0) {
+        selfPlay<Size>();
+        return 0;
+    }
+
+    EngineConfig a, b;
+    string openingsPath, recordPath;
+    int games = 200, threads = (int) max(1u, thread::hardware_concurrency());
+    double elo0 = 0, elo1 = 10;
+    for (int i = 2; i < argc; i += 2) {
+        if (i + 1 == argc) {
+            std::cerr << "Missing value of " << argv[i] << std::endl;
+            return 1;
+        }
+        bool ok = true;
+        if (!strcmp(argv[i], "--a")) ok = a.parse(argv[i + 1]);
+        else if (!strcmp(argv[i], "--b")) ok = b.parse(argv[i + 1]);
+        else if (!strcmp(argv[i], "--openings")) openingsPath = argv[i + 1];
+        else if (!strcmp(argv[i], "--record")) recordPath = argv[i + 1];
+        else if (!strcmp(argv[i], "--games")) games = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--threads")) threads = atoi(argv[i + 1]);
+        else if (!strcmp(argv[i], "--elo0")) elo0 = atof(argv[i + 1]);
+        else if (!strcmp(argv[i], "--elo1")) elo1 = atof(argv[i + 1]);
+        else ok = false;
+        if (!ok) {
+            std::cerr << "Bad option " << argv[i] << " " << argv[i + 1] << std::endl;
+            return 1;
+        }
+    }
+
+    auto openings = loadOpenings(openingsPath);
+    if (openings.empty()) {
+        std::cerr << "No openings in " << openingsPath << std::endl;
+        return 1;
+    }
+    for (const auto &opening : openings)
+        for (auto m : opening)
+            if (m.x < 0 || m.y < 0 || m.x >= Size || m.y >= Size) {
+                std::cerr << "Opening move out of the board: " << m.x << "," << m.y << std::endl;
+                return 1;
+            }
+    GameRecordWriter record;
+    if (!recordPath.empty() && !record.open(recordPath, Size)) {
+        std::cerr << "Cannot append to the game records " << recordPath << std::endl;
+        return 1;
+    }
+    return tournament<Size>(openings, a, b, games, threads, elo0, elo1, recordPath.empty() ? nullptr : &record);
+}
+
+/*
+ * Usage: LocalTest [board size = 15 | 19 | 20] [--tournament [options]]
+ * Without --tournament, plays one verbose self-play game.
+ * Tournament options:
+ *   --a, --b SPEC       engine settings, e.g. "weight=0,prune=10,depth=8,time=990,nodes=0,sym=1", and
+ *                       weights=FILE for the weights of a file, see PatternWeights.h, and search=FILE for the
+ *                       search settings of a file written by Spsa
+ *   --openings FILE     one opening per line as "row,column" moves, defaults to the recorded games
+ *   --games N = 200     --threads N = all cores     --elo0 E = 0     --elo1 E = 10
+ *   --record FILE       append the games with the search result of each move, see GameRecord.h
+ */
+int main(int argc, char **argv) {
+    int size = BOARD_SIZE;
+    if (argc > 1 && isdigit(argv[1][0])) {
+        size = atoi(argv[1]);
+        argv[1] = argv[0];
+        argc--;
+        argv++;
+    }
+    switch (size) {
+        case 15:
+            return run<15>(argc, argv);
+        case 19:
+            return run<19>(argc, argv);
+        case 20:
+            return run<20>(argc, argv);
+        default:
+            std::cerr << "Unsupported board size: " << size << std::endl;
+            return 1;
+    }
 }